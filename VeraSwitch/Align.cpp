@@ -0,0 +1,280 @@
+#include "Align.h"
+#include "Random.h"
+#include <algorithm>
+#include <chrono>
+#include <doctest\doctest.h>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+namespace {
+    using namespace AARC::Align;
+
+    // Bars of the longest series per time chunk
+    constexpr size_t chunk_bars = 4096;
+
+    // One series' timestamps and the chosen field in time order, without the repeats
+    struct Column {
+        std::vector<size_t> ts_;
+        std::vector<float>  v_;
+    };
+
+    auto column(const AARC::TSData &s, const Field field) -> Column {
+        using namespace std;
+        const auto &src = field == Field::OPEN ? s.open_ : field == Field::HIGH ? s.high_
+                                                       : field == Field::LOW  ? s.low_
+                                                                              : s.close_;
+        const auto  n   = min(s.ts_.size(), src.size());
+        auto        order = vector<size_t>(n);
+        iota(begin(order), end(order), size_t(0));
+        if (!is_sorted(begin(s.ts_), begin(s.ts_) + n)) {
+            stable_sort(begin(order), end(order), [&](const size_t a, const size_t b) { return s.ts_[a] < s.ts_[b]; });
+        }
+        auto out = Column();
+        out.ts_.reserve(n);
+        out.v_.reserve(n);
+        for (const auto i : order) {
+            if (!out.ts_.empty() && out.ts_.back() == s.ts_[i]) {
+                out.v_.back() = src[i];
+            } else {
+                out.ts_.emplace_back(s.ts_[i]);
+                out.v_.emplace_back(src[i]);
+            }
+        }
+        return out;
+    }
+
+    // Rows of one time chunk, row-major until the chunks are stitched together
+    struct Rows {
+        std::vector<size_t> ts_;
+        std::vector<float>  v_;
+    };
+
+    // Timestamps in [lo, hi) that every column has
+    auto intersect(const std::vector<Column> &cols, const size_t lo, const size_t hi) -> Rows {
+        using namespace std;
+        const auto k   = cols.size();
+        auto       out = Rows();
+        auto       at  = vector<size_t>(k);
+        for (auto a = size_t(0); a < k; ++a) {
+            at[a] = lower_bound(begin(cols[a].ts_), end(cols[a].ts_), lo) - begin(cols[a].ts_);
+        }
+        auto a = size_t(0), agreed = size_t(0);
+        auto candidate = lo;
+        // Each column in turn catches up to the candidate, a later timestamp becomes the new candidate
+        while (true) {
+            const auto &ts = cols[a].ts_;
+            while (at[a] < ts.size() && ts[at[a]] < candidate) ++at[a];
+            if (at[a] == ts.size() || ts[at[a]] >= hi) break;
+            if (ts[at[a]] == candidate) {
+                ++agreed;
+            } else {
+                candidate = ts[at[a]];
+                agreed    = 1;
+            }
+            if (agreed == k) {
+                out.ts_.emplace_back(candidate);
+                for (auto b = size_t(0); b < k; ++b) out.v_.emplace_back(cols[b].v_[at[b]]);
+                ++candidate;
+                agreed = 0;
+            }
+            a = (a + 1) % k;
+        }
+        return out;
+    }
+
+    // Every timestamp in [lo, hi) any column has, carrying forward the last value seen
+    auto merge(const std::vector<Column> &cols, const size_t lo, const size_t hi) -> Rows {
+        using namespace std;
+        const auto k    = cols.size();
+        auto       out  = Rows();
+        auto       at   = vector<size_t>(k);
+        auto       last = vector<float>(k);
+        for (auto a = size_t(0); a < k; ++a) {
+            at[a]   = lower_bound(begin(cols[a].ts_), end(cols[a].ts_), lo) - begin(cols[a].ts_);
+            last[a] = at[a] > 0 ? cols[a].v_[at[a] - 1] : numeric_limits<float>::quiet_NaN();
+        }
+        while (true) {
+            auto next = hi;
+            for (auto a = size_t(0); a < k; ++a) {
+                if (at[a] < cols[a].ts_.size()) next = min(next, cols[a].ts_[at[a]]);
+            }
+            if (next >= hi) break;
+            for (auto a = size_t(0); a < k; ++a) {
+                if (at[a] < cols[a].ts_.size() && cols[a].ts_[at[a]] == next) last[a] = cols[a].v_[at[a]++];
+            }
+            out.ts_.emplace_back(next);
+            out.v_.insert(end(out.v_), begin(last), end(last));
+        }
+        return out;
+    }
+} // namespace
+
+auto AARC::Align::align(const std::vector<TSData> &series, const Fill fill, const Field field) -> Panel {
+    using namespace std;
+    MethodLogger mlog("Align::align");
+    const auto   k   = series.size();
+    auto         out = Panel();
+    auto         cols = vector<Column>(k);
+    concurrency::parallel_for(size_t(0), k, [&](const size_t a) { cols[a] = column(series[a], field); });
+    // Every asset is listed even when one has no bars and the panel is left empty
+    for (const auto &s : series) out.assets_.emplace_back(s.asset_);
+    for (auto a = size_t(0); a < k; ++a) {
+        if (cols[a].ts_.empty()) {
+            mlog.logger()->error("No bars for asset {}", series[a].asset_);
+            return out;
+        }
+    }
+    if (k == 0) return out;
+
+    // Chunks split at evenly spaced bars of the longest series, nothing before every asset has started
+    auto start = size_t(0);
+    for (const auto &c : cols) start = max(start, c.ts_.front());
+    const auto &longest = *max_element(begin(cols), end(cols),
+                                       [](const Column &a, const Column &b) { return a.ts_.size() < b.ts_.size(); });
+    auto        bounds  = vector<size_t>{start};
+    for (auto i = chunk_bars; i < longest.ts_.size(); i += chunk_bars) {
+        if (longest.ts_[i] > bounds.back()) bounds.emplace_back(longest.ts_[i]);
+    }
+    bounds.emplace_back(numeric_limits<size_t>::max());
+    const auto chunks = bounds.size() - 1;
+    auto       parts  = vector<Rows>(chunks);
+    concurrency::parallel_for(size_t(0), chunks, [&](const size_t c) {
+        parts[c] = fill == Fill::DROP ? intersect(cols, bounds[c], bounds[c + 1])
+                                      : merge(cols, bounds[c], bounds[c + 1]);
+    });
+
+    // Stitched into columns, each chunk writes its own rows
+    auto first = vector<size_t>(chunks + 1, 0);
+    for (auto c = size_t(0); c < chunks; ++c) first[c + 1] = first[c] + parts[c].ts_.size();
+    const auto rows = first[chunks];
+    out.ts_.resize(rows);
+    out.values_.resize(rows * k);
+    concurrency::parallel_for(size_t(0), chunks, [&](const size_t c) {
+        const auto &p = parts[c];
+        copy(begin(p.ts_), end(p.ts_), begin(out.ts_) + first[c]);
+        for (auto r = size_t(0); r < p.ts_.size(); ++r) {
+            for (auto a = size_t(0); a < k; ++a) out.values_[a * rows + first[c] + r] = p.v_[r * k + a];
+        }
+    });
+    return out;
+}
+
+namespace {
+    auto bars(const uint64_t asset, const std::vector<size_t> &ts, const std::vector<float> &close) -> AARC::TSData {
+        return AARC::TSData(asset, ts, close, close, close, close);
+    }
+
+    // Reference join through a map of every timestamp, one row at a time
+    auto naive(const std::vector<AARC::TSData> &series, const Fill fill) -> Panel {
+        auto seen = std::map<size_t, std::vector<std::pair<bool, float>>>();
+        for (auto a = size_t(0); a < series.size(); ++a) {
+            for (auto i = size_t(0); i < series[a].ts_.size(); ++i) {
+                auto &row = seen[series[a].ts_[i]];
+                row.resize(series.size());
+                row[a] = std::make_pair(true, series[a].close_[i]);
+            }
+        }
+        auto out  = Panel();
+        auto last = std::vector<std::pair<bool, float>>(series.size());
+        auto rows = std::vector<std::vector<float>>();
+        for (auto &r : seen) {
+            r.second.resize(series.size());
+            auto all = true, live = true;
+            for (auto a = size_t(0); a < series.size(); ++a) {
+                if (r.second[a].first) last[a] = r.second[a];
+                all  = all && r.second[a].first;
+                live = live && last[a].first;
+            }
+            if (fill == Fill::DROP ? !all : !live) continue;
+            out.ts_.emplace_back(r.first);
+            rows.emplace_back();
+            for (const auto &l : last) rows.back().emplace_back(l.second);
+        }
+        for (auto a = size_t(0); a < series.size(); ++a) {
+            for (const auto &r : rows) out.values_.emplace_back(r[a]);
+        }
+        return out;
+    }
+} // namespace
+
+TEST_CASE("Align small panel") {
+    using namespace AARC::Align;
+    const auto series = std::vector<AARC::TSData>{bars(1, {1, 2, 3, 5, 6}, {10, 11, 12, 13, 14}),
+                                                  bars(2, {5, 2, 3, 7, 3}, {25, 22, 23, 27, 24}),
+                                                  bars(3, {2, 3, 4, 5, 6, 7}, {32, 33, 34, 35, 36, 37})};
+    const auto drop   = align(series, Fill::DROP);
+    CHECK(drop.assets_ == std::vector<uint64_t>{1, 2, 3});
+    CHECK(drop.ts_ == std::vector<size_t>{2, 3, 5});
+    // Asset 2 arrived out of order with 3 repeated, the later bar wins
+    CHECK(drop.values_ == std::vector<float>{11, 12, 13, 22, 24, 25, 32, 33, 35});
+    CHECK(drop.column(1)[1] == 24);
+
+    auto with_empty = series;
+    with_empty.insert(begin(with_empty) + 1, AARC::TSData());
+    with_empty[1].asset_ = 4;
+    const auto empty     = align(with_empty, Fill::DROP);
+    CHECK(empty.assets_ == std::vector<uint64_t>{1, 4, 2, 3});
+    CHECK(empty.ts_.empty());
+
+    const auto ffill = align(series, Fill::FORWARD);
+    CHECK(ffill.ts_ == std::vector<size_t>{2, 3, 4, 5, 6, 7});
+    CHECK(ffill.values_ == std::vector<float>{11, 12, 12, 13, 14, 14, 22, 24, 24, 25, 25, 27, 32, 33, 34, 35, 36, 37});
+
+    CHECK(align(std::vector<AARC::TSData>{bars(1, {1}, {1}), bars(2, {}, {})}).ts_.empty());
+    CHECK(align(series, Fill::DROP, Field::OPEN).values_ == drop.values_);
+}
+
+TEST_CASE("Align across chunks") {
+    using namespace AARC::Align;
+    // Each asset misses a random 20% of 30000 timestamps, enough bars for several chunks
+    auto stream = AARC::Random::Stream{11};
+    auto u      = std::vector<double>(6 * 30000);
+    AARC::Random::uniform(stream, u.data(), u.size());
+    auto series = std::vector<AARC::TSData>();
+    for (auto a = size_t(0); a < 6; ++a) {
+        auto ts    = std::vector<size_t>();
+        auto close = std::vector<float>();
+        for (auto t = size_t(0); t < 30000; ++t) {
+            if (u[a * 30000 + t] < 0.2) continue;
+            ts.emplace_back(100 + 3 * t);
+            close.emplace_back(float(a * 100000 + t));
+        }
+        series.emplace_back(bars(a, ts, close));
+    }
+    for (const auto fill : {Fill::DROP, Fill::FORWARD}) {
+        const auto p = align(series, fill), expected = naive(series, fill);
+        CHECK(p.ts_ == expected.ts_);
+        CHECK(p.values_ == expected.values_);
+    }
+}
+
+TEST_CASE("Align benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::Align;
+    using namespace std::chrono;
+    const auto assets = size_t(500), days = size_t(2500);
+    auto       stream = AARC::Random::Stream{12};
+    auto       u      = std::vector<double>(assets * days);
+    AARC::Random::uniform(stream, u.data(), u.size());
+    auto series = std::vector<AARC::TSData>();
+    for (auto a = size_t(0); a < assets; ++a) {
+        auto ts    = std::vector<size_t>();
+        auto close = std::vector<float>();
+        for (auto t = size_t(0); t < days; ++t) {
+            if (u[a * days + t] < 0.02) continue;
+            ts.emplace_back(t);
+            close.emplace_back(100.0f);
+        }
+        series.emplace_back(bars(a, ts, close));
+    }
+    auto       start   = high_resolution_clock::now();
+    const auto drop    = align(series, Fill::DROP);
+    const auto drop_us = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    start              = high_resolution_clock::now();
+    const auto ffill   = align(series, Fill::FORWARD);
+    const auto ff_us   = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    CHECK(drop.ts_.size() < ffill.ts_.size());
+    spdlog::get("logger")->info("Align 500 assets x 2500 days drop {}us, forward fill {}us", drop_us, ff_us);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "TimeSeries.h"
+#include <cstdint>
+#include <vector>
+
+namespace AARC {
+    namespace Align {
+        /* Lines several assets' bars up on their timestamps. The series are merged k ways in one pass over their
+        sorted ts_ columns, split into time chunks that are joined in parallel, each chunk picking up the value in
+        force at its start from just before it. The result is one column-major matrix so a kernel can run down an
+        asset's column */
+
+        // DROP keeps the timestamps every asset has, FORWARD every timestamp any asset has with the gaps filled by
+        // the last value. FORWARD starts once all the assets have a value so there are no holes in the panel
+        enum class Fill { DROP, FORWARD };
+        enum class Field { OPEN, HIGH, LOW, CLOSE };
+
+        struct Panel {
+            std::vector<uint64_t> assets_;
+            std::vector<size_t>   ts_;
+            std::vector<float>    values_; // values_[a * ts_.size() + t]
+
+            auto column(const size_t a) const -> const float * { return values_.data() + a * ts_.size(); }
+        };
+
+        // Series out of time order are sorted first, of repeated timestamps the last bar is used
+        auto align(const std::vector<TSData> &series, const Fill fill = Fill::DROP, const Field field = Field::CLOSE)
+            -> Panel;
+    } // namespace Align
+} // namespace AARC
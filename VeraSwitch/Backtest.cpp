@@ -0,0 +1,283 @@
+#include "Backtest.h"
+#include "Random.h"
+#include "Split.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+namespace {
+    using namespace AARC::Backtest;
+
+    // Strategies run together by one task, and bars per call into the kernel so a block of signals stays in cache
+    constexpr size_t group      = 64;
+    constexpr size_t chunk_bars = 4096;
+
+    // Rows of the kernel's state and rules, see backtest_bars
+    enum { POSITION, ENTRY, MARK, HELD, EQUITY, PEAK, DRAWDOWN, TRADE_START, SUM, SUM_SQ, WINS, TRADES, STATE_ROWS };
+    enum { STOP, TARGET, COST, MAX_BARS, REVERSE, RULE_ROWS };
+
+    auto totals(const double *state, const size_t count, const size_t k) -> Totals {
+        return Totals{state[EQUITY * count + k], state[SUM * count + k], state[SUM_SQ * count + k],
+                      state[WINS * count + k], state[TRADES * count + k]};
+    }
+
+    /* Backtests over bars [begin, end), results and the totals at each checkpoint (ascending, inside the range) are
+     * filled in for the strategies, equity curves only if asked for */
+    auto simulate(const AARC::TSData &bars, const std::vector<Signals> &signals, const std::vector<Rules> &rules,
+                  const size_t begin, const size_t end, const std::vector<size_t> &checkpoints,
+                  const double bars_per_year, const bool equity, std::vector<Result> &out,
+                  std::vector<std::vector<Totals>> &marks) -> void {
+        using namespace std;
+        const auto n = end - begin;
+        concurrency::parallel_for(size_t(0), (rules.size() + group - 1) / group, [&](const size_t g) {
+            const auto first = g * group, count = min(group, rules.size() - first);
+            auto       rule  = vector<double>(RULE_ROWS * count);
+            auto       state = vector<double>(STATE_ROWS * count, 0.0);
+            for (auto k = size_t(0); k < count; ++k) {
+                const auto &r              = rules[first + k];
+                rule[STOP * count + k]     = r.stop_;
+                rule[TARGET * count + k]   = r.target_;
+                rule[COST * count + k]     = r.cost_;
+                rule[MAX_BARS * count + k] = static_cast<double>(r.max_bars_);
+                rule[REVERSE * count + k]  = r.reverse_ ? 1.0 : 0.0;
+                state[EQUITY * count + k]  = 1.0;
+                state[PEAK * count + k]    = 1.0;
+                if (equity) out[first + k].equity_.resize(n);
+                marks[first + k].reserve(checkpoints.size());
+            }
+            auto side = vector<int8_t>(chunk_bars * count);
+            auto eq   = vector<float>(chunk_bars * count);
+            auto next = std::begin(checkpoints);
+            auto mark = [&]() {
+                for (auto k = size_t(0); k < count; ++k) marks[first + k].emplace_back(totals(state.data(), count, k));
+            };
+            for (auto b0 = begin; b0 < end;) {
+                // Chunks stop at each checkpoint so the totals can be read off there
+                for (; next != std::end(checkpoints) && *next <= b0; ++next) mark();
+                const auto stop = next == std::end(checkpoints) ? end : min(end, *next);
+                const auto m    = min(chunk_bars, stop - b0);
+                // Bar b acts on the signal from the close of bar b - 1
+                for (auto k = size_t(0); k < count; ++k) {
+                    const auto &s = signals.size() == 1 ? signals.front() : signals[first + k];
+                    for (auto b = b0; b < b0 + m; ++b) {
+                        const auto i = static_cast<int64_t>(b) - 1 - static_cast<int64_t>(s.offset_);
+                        const auto v = i >= 0 && size_t(i) < s.side_.size() ? s.side_[i] : 0;
+                        side[(b - b0) * count + k] = static_cast<int8_t>(v > 0 ? 1 : v < 0 ? -1 : 0);
+                    }
+                }
+                ispc::backtest_bars(bars.open_.data() + b0, bars.high_.data() + b0, bars.low_.data() + b0,
+                                    bars.close_.data() + b0, side.data(), m, count, rule.data(), state.data(),
+                                    eq.data());
+                if (equity) {
+                    for (auto k = size_t(0); k < count; ++k) {
+                        auto &curve = out[first + k].equity_;
+                        for (auto b = size_t(0); b < m; ++b) curve[b0 - begin + b] = eq[b * count + k];
+                    }
+                }
+                b0 += m;
+            }
+            for (; next != std::end(checkpoints); ++next) mark();
+            for (auto k = size_t(0); k < count; ++k) {
+                out[first + k].stats_               = stats(Totals(), totals(state.data(), count, k), n, bars_per_year);
+                out[first + k].stats_.max_drawdown_ = state[DRAWDOWN * count + k];
+            }
+        });
+    }
+
+    auto valid(const AARC::TSData &bars, const std::vector<Signals> &signals, const std::vector<Rules> &rules,
+               MethodLogger &mlog) -> bool {
+        const auto n = bars.ts_.size();
+        if (signals.size() != 1 && signals.size() != rules.size()) {
+            mlog.logger()->error("{} sets of signals for {} rules", signals.size(), rules.size());
+            return false;
+        }
+        if (bars.open_.size() != n || bars.high_.size() != n || bars.low_.size() != n || bars.close_.size() != n) {
+            mlog.logger()->error("Bars of asset {} have columns of different lengths", bars.asset_);
+            return false;
+        }
+        return true;
+    }
+} // namespace
+
+auto AARC::Backtest::threshold(const std::vector<float> &indicator, const size_t offset, const float lower,
+                               const float upper) -> Signals {
+    auto out = Signals{std::vector<int>(indicator.size(), 0), offset};
+    for (auto i = size_t(1); i < indicator.size(); ++i) {
+        if (indicator[i] < lower && indicator[i - 1] >= lower) out.side_[i] = 1;
+        if (indicator[i] > upper && indicator[i - 1] <= upper) out.side_[i] = -1;
+    }
+    return out;
+}
+
+auto AARC::Backtest::stats(const Totals &from, const Totals &to, const size_t bars, const double bars_per_year)
+    -> Stats {
+    auto       out  = Stats();
+    const auto mean = bars > 0 ? (to.sum_ - from.sum_) / bars : 0.0;
+    const auto var  = bars > 1 ? (to.sum_sq_ - from.sum_sq_ - mean * mean * bars) / (bars - 1) : 0.0;
+    out.total_return_ = to.equity_ / from.equity_ - 1.0;
+    out.sharpe_       = var > 0.0 ? mean / std::sqrt(var) * std::sqrt(bars_per_year) : 0.0;
+    out.trades_       = static_cast<size_t>(to.trades_ - from.trades_);
+    out.win_rate_     = out.trades_ > 0 ? (to.wins_ - from.wins_) / out.trades_ : 0.0;
+    return out;
+}
+
+auto AARC::Backtest::run(const TSData &bars, const Signals &signals, const Rules &rules, const double bars_per_year)
+    -> Result {
+    return run(bars, signals, rules, 0, bars.ts_.size(), bars_per_year);
+}
+
+auto AARC::Backtest::run(const TSData &bars, const Signals &signals, const Rules &rules, const size_t begin,
+                         const size_t end, const double bars_per_year) -> Result {
+    MethodLogger mlog("Backtest::run");
+    const auto   s = std::vector<Signals>{signals};
+    const auto   r = std::vector<Rules>{rules};
+    if (!valid(bars, s, r, mlog) || begin > end || end > bars.ts_.size()) return Result();
+    auto out   = std::vector<Result>(1);
+    auto marks = std::vector<std::vector<Totals>>(1);
+    simulate(bars, s, r, begin, end, std::vector<size_t>(), bars_per_year, true, out, marks);
+    return std::move(out.front());
+}
+
+auto AARC::Backtest::run(const TSData &bars, const std::vector<Signals> &signals, const std::vector<Rules> &rules,
+                         const double bars_per_year, const bool equity) -> std::vector<Result> {
+    MethodLogger mlog("Backtest::run");
+    if (!valid(bars, signals, rules, mlog)) return std::vector<Result>();
+    auto out   = std::vector<Result>(rules.size());
+    auto marks = std::vector<std::vector<Totals>>(rules.size());
+    simulate(bars, signals, rules, 0, bars.ts_.size(), std::vector<size_t>(), bars_per_year, equity, out, marks);
+    return out;
+}
+
+auto AARC::Backtest::totals(const TSData &bars, const std::vector<Signals> &signals, const std::vector<Rules> &rules,
+                            const std::vector<size_t> &checkpoints) -> std::vector<std::vector<Totals>> {
+    MethodLogger mlog("Backtest::totals");
+    if (!valid(bars, signals, rules, mlog)) return std::vector<std::vector<Totals>>();
+    if (!std::is_sorted(std::begin(checkpoints), std::end(checkpoints))) {
+        mlog.logger()->error("Checkpoints out of order");
+        return std::vector<std::vector<Totals>>();
+    }
+    auto out   = std::vector<Result>(rules.size());
+    auto marks = std::vector<std::vector<Totals>>(rules.size());
+    simulate(bars, signals, rules, 0, bars.ts_.size(), checkpoints, 252.0, false, out, marks);
+    return marks;
+}
+
+namespace {
+    auto bars(const std::vector<std::array<float, 4>> &ohlc) -> AARC::TSData {
+        auto out = AARC::TSData();
+        for (auto i = size_t(0); i < ohlc.size(); ++i) {
+            out.ts_.emplace_back(i);
+            out.open_.emplace_back(ohlc[i][0]);
+            out.high_.emplace_back(ohlc[i][1]);
+            out.low_.emplace_back(ohlc[i][2]);
+            out.close_.emplace_back(ohlc[i][3]);
+        }
+        return out;
+    }
+} // namespace
+
+TEST_CASE("Backtest trades") {
+    using namespace AARC::Backtest;
+    const auto b = bars({{{100, 101, 99, 100}},
+                         {{100, 101, 99, 100}},
+                         {{100, 103, 99, 102}},
+                         {{102, 106, 101, 105}},
+                         {{105, 112, 104, 110}},
+                         {{110, 111, 109, 110}},
+                         {{110, 111, 108, 109}},
+                         {{120, 121, 119, 120}},
+                         {{120, 121, 119, 120}},
+                         {{120, 121, 119, 120}}});
+    // Long on bar 1's close, out at the 10% target on bar 4. Short on bar 5's close and stopped by the gap on bar 7
+    auto signals  = Signals{{0, 1, 0, 0, 0, -1, 0, 0, 0, 0}, 0};
+    auto rules    = Rules();
+    rules.stop_   = 0.05f;
+    rules.target_ = 0.1f;
+    rules.cost_   = 0.001f;
+    const auto r  = run(b, signals, rules);
+    const auto c  = 0.999;
+    const auto e6 = c * c * 1.1 * c * (1.0 + 1.0 / 110.0);
+    REQUIRE(r.equity_.size() == 10);
+    CHECK(r.equity_[1] == 1.0f);
+    CHECK(r.equity_[2] == doctest::Approx(c * 1.02));
+    CHECK(r.equity_[4] == doctest::Approx(c * c * 1.1));
+    CHECK(r.equity_[6] == doctest::Approx(e6));
+    CHECK(r.equity_[9] == doctest::Approx(e6 * (2.0 - 120.0 / 109.0) * c));
+    CHECK(r.stats_.trades_ == 2);
+    CHECK(r.stats_.win_rate_ == 0.5);
+    CHECK(r.stats_.total_return_ == doctest::Approx(r.equity_[9] - 1.0));
+    CHECK(r.stats_.max_drawdown_ == doctest::Approx(1.0 - (2.0 - 120.0 / 109.0) * c));
+
+    // Without reversing the short on bar 3 only closes the long at the next open, a time exit gets out after 2 bars
+    signals.side_[3] = -1;
+    rules            = Rules();
+    rules.reverse_   = false;
+    const auto flat  = run(b, signals, rules);
+    CHECK(flat.equity_[4] == doctest::Approx(105.0 / 100.0));
+    CHECK(flat.stats_.trades_ == 1);
+    rules.max_bars_ = 2;
+    CHECK(run(b, Signals{{1}, 0}, rules).equity_[9] == doctest::Approx(102.0 / 100.0));
+}
+
+TEST_CASE("Backtest many strategies") {
+    using namespace AARC::Backtest;
+    const auto b = AARC::Random::walk(20000, 3, AARC::Random::Walk{0.001, 0.0005});
+    // An oscillating indicator offset from the bars, as a TA output would be
+    auto       u = std::vector<double>(b.ts_.size() - 14);
+    auto       s = AARC::Random::Stream{4};
+    AARC::Random::uniform(s, u.data(), u.size());
+    auto indicator = std::vector<float>(u.size());
+    std::transform(begin(u), end(u), begin(indicator), [](const double v) { return float(100.0 * v); });
+    const auto signals = threshold(indicator, 14, 10.0f, 90.0f);
+
+    auto rules = std::vector<Rules>();
+    for (const auto stop : {0.0f, 0.002f, 0.005f}) {
+        for (const auto target : {0.0f, 0.003f, 0.01f}) {
+            for (const auto max_bars : {0, 5, 30, 100}) {
+                for (const auto reverse : {true, false}) {
+                    rules.emplace_back(Rules{stop, target, size_t(max_bars), 0.0002f, reverse});
+                }
+            }
+        }
+    }
+    const auto all = run(b, std::vector<Signals>{signals}, rules, 252.0 * 390.0, true);
+    REQUIRE(all.size() == rules.size());
+    // Groups of strategies and chunks of bars give what each would alone
+    for (auto k = size_t(0); k < rules.size(); k += 7) {
+        const auto one = run(b, signals, rules[k], 252.0 * 390.0);
+        CHECK(all[k].equity_ == one.equity_);
+        CHECK(all[k].stats_.sharpe_ == one.stats_.sharpe_);
+        CHECK(all[k].stats_.trades_ == one.stats_.trades_);
+    }
+    CHECK(all[0].stats_.trades_ > 100);
+
+    // Long from the first bar with no costs is the asset's own return from the second bar's open
+    const auto hold = run(b, Signals{{1}, 0}, Rules());
+    CHECK(hold.stats_.total_return_ == doctest::Approx(b.close_.back() / b.open_[1] - 1.0).epsilon(1e-5));
+    CHECK(hold.stats_.trades_ == 0);
+}
+
+TEST_CASE("Backtest benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::Backtest;
+    using namespace std::chrono;
+    const auto b     = AARC::Random::walk(100000, 5, AARC::Random::Walk{0.001, 0.0005});
+    auto       rules = std::vector<Rules>();
+    for (auto i = 0; i < 512; ++i) {
+        rules.emplace_back(Rules{0.001f * (i % 8), 0.001f * (i / 8 % 8), size_t(i / 64) * 10});
+    }
+    auto signals = std::vector<Signals>();
+    for (auto i = 0; i < 512; ++i) {
+        auto side = std::vector<int>(b.ts_.size(), 0);
+        for (auto j = size_t(i % 97); j < side.size(); j += 200 + i) side[j] = j % 3 == 0 ? -1 : 1;
+        signals.emplace_back(Signals{side, 0});
+    }
+    const auto start = high_resolution_clock::now();
+    const auto out   = run(b, signals, rules, 252.0 * 390.0);
+    const auto ms    = duration_cast<milliseconds>(high_resolution_clock::now() - start).count();
+    CHECK(out.size() == 512);
+    spdlog::get("logger")->info("Backtest 512 strategies x 100000 minute bars {}ms", ms);
+}
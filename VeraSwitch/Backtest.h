@@ -0,0 +1,75 @@
+#pragma once
+#include "TimeSeries.h"
+#include <vector>
+
+namespace AARC {
+    namespace Backtest {
+        /* Long/short backtests of TA signals on one asset's bars. A signal on a bar's close is filled at the next
+        bar's open, stops and targets are checked against each bar's range (a gap through the level fills at the
+        open, a bar reaching both is taken as stopped) and time exits go at the close. Each trade is the whole of
+        equity and costs are a fraction of the traded value each side. Strategies over the same bars are run
+        together, their state laid out SoA so a gang takes several strategies through a bar at once */
+
+        // side_[i] is +1 to go long, -1 to go short or 0 to carry on, decided at the close of bar offset_ + i
+        struct Signals {
+            std::vector<int> side_;
+            size_t           offset_ = 0;
+        };
+
+        /* Long where the indicator crosses below lower and short where it crosses above upper, for an oscillator
+         * whose value indicator[i] is bar offset + i (TA::rsi is offset by its period) */
+        auto threshold(const std::vector<float> &indicator, const size_t offset, const float lower, const float upper)
+            -> Signals;
+
+        struct Rules {
+            float  stop_     = 0.0f; // Fractions of the entry price, 0 for none
+            float  target_   = 0.0f;
+            size_t max_bars_ = 0;    // Bars held before exiting at the close, 0 for no limit
+            float  cost_     = 0.0f; // Commission and slippage per side as a fraction of the traded value
+            bool   reverse_  = true; // An opposite signal turns the position round, otherwise it only exits
+        };
+
+        struct Stats {
+            double total_return_ = 0.0;
+            double sharpe_       = 0.0; // Of the bar returns, annualised
+            double max_drawdown_ = 0.0; // Fraction of the peak
+            double win_rate_     = 0.0; // Closed trades only, a position still open at the end isn't counted
+            size_t trades_       = 0;
+        };
+
+        struct Result {
+            Stats              stats_;
+            std::vector<float> equity_; // At each close, starting from 1
+        };
+
+        auto run(const TSData &bars, const Signals &signals, const Rules &rules, const double bars_per_year = 252.0)
+            -> Result;
+
+        // Only bars [begin, end), flat at the start. Equity is indexed from begin
+        auto run(const TSData &bars, const Signals &signals, const Rules &rules, const size_t begin, const size_t end,
+                 const double bars_per_year = 252.0) -> Result;
+
+        /* One backtest per rules, against signals in the same order or all against one set of signals. Equity curves
+         * are only kept if asked for, over years of minute bars they are most of the memory */
+        auto run(const TSData &bars, const std::vector<Signals> &signals, const std::vector<Rules> &rules,
+                 const double bars_per_year = 252.0, const bool equity = false) -> std::vector<Result>;
+
+        /* Running totals of a backtest at the start of a bar. The difference between two is the stats of the bars in
+         * between as if the strategy had been running all along, apart from the drawdown */
+        struct Totals {
+            double equity_ = 1.0;
+            double sum_    = 0.0; // Of the bar returns
+            double sum_sq_ = 0.0;
+            double wins_   = 0.0;
+            double trades_ = 0.0;
+        };
+
+        // totals[k][c] is backtest k's totals at checkpoints[c], for one pass over every bar however many checkpoints
+        auto totals(const TSData &bars, const std::vector<Signals> &signals, const std::vector<Rules> &rules,
+                    const std::vector<size_t> &checkpoints) -> std::vector<std::vector<Totals>>;
+
+        // Stats of the bars between two totals, without the drawdown
+        auto stats(const Totals &from, const Totals &to, const size_t bars, const double bars_per_year = 252.0)
+            -> Stats;
+    } // namespace Backtest
+} // namespace AARC
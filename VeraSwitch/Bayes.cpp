@@ -0,0 +1,311 @@
+#include "Bayes.h"
+#include "Random.h"
+#include "Split.h"
+#include "TechnicalAnalysis.h"
+#include "TimeSeries.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+namespace {
+    using namespace AARC::Bayes;
+
+    // Bars per task, both for counting and scoring
+    constexpr size_t chunk = 16384;
+
+    // Bars [begin, end) that every feature covers
+    auto coverage(const std::vector<Feature> &features) -> std::pair<size_t, size_t> {
+        auto begin = size_t(0), end = std::numeric_limits<size_t>::max();
+        for (const auto &f : features) {
+            begin = std::max(begin, f.offset_);
+            end   = std::min(end, f.offset_ + f.values_.size());
+        }
+        return std::make_pair(begin, std::max(begin, end));
+    }
+
+    // Training and the scoring kernel both multiply by this, dividing can put a value on a bin edge one bin over
+    auto inv_width(const Binning &b) -> float { return 1.0f / b.width_; }
+
+    auto bin(const Binning &b, const float x) -> size_t {
+        const auto v = std::floor((x - b.lo_) * inv_width(b));
+        return static_cast<size_t>(std::min(std::max(v, 0.0f), static_cast<float>(b.bins_ - 1)));
+    }
+
+    auto direction(const Model &m, const float r) -> size_t { return r > m.flat_ ? UP : r < -m.flat_ ? DOWN : FLAT; }
+
+    auto probabilities(Model &m) -> void {
+        const auto total = m.first_.back();
+        auto       n     = 0.0;
+        for (const auto c : m.class_counts_) n += c;
+        for (auto c = size_t(0); c < DIRECTIONS; ++c) {
+            const auto prior = (m.class_counts_[c] + m.alpha_) / (n + m.alpha_ * DIRECTIONS);
+            m.log_prior_[c]  = static_cast<float>(std::log(prior));
+            for (auto f = size_t(0); f < m.bins_.size(); ++f) {
+                const auto denominator = m.class_counts_[c] + m.alpha_ * m.bins_[f].bins_;
+                for (auto b = m.first_[f]; b < m.first_[f + 1]; ++b) {
+                    m.log_prob_[c * total + b] =
+                        static_cast<float>(std::log((m.counts_[c * total + b] + m.alpha_) / denominator));
+                }
+            }
+        }
+    }
+} // namespace
+
+auto AARC::Bayes::binning(const std::vector<float> &values, const size_t bins) -> Binning {
+    using namespace std;
+    if (values.empty() || bins == 0) return Binning{0.0f, 1.0f, max<size_t>(bins, 1)};
+    auto       sorted = values;
+    const auto lo = sorted.begin() + sorted.size() / 100, hi = sorted.begin() + (sorted.size() * 99) / 100;
+    nth_element(begin(sorted), lo, end(sorted));
+    const auto low = *lo;
+    nth_element(begin(sorted), hi, end(sorted));
+    const auto width = (*hi - low) / bins;
+    return Binning{low, width > 0.0f ? width : 1.0f, bins};
+}
+
+auto AARC::Bayes::model(const std::vector<Binning> &bins, const float flat, const double alpha, const double decay)
+    -> Model {
+    auto m   = Model();
+    m.bins_  = bins;
+    m.flat_  = flat;
+    m.alpha_ = alpha;
+    m.decay_ = decay;
+    m.first_.emplace_back(0);
+    for (const auto &b : bins) m.first_.emplace_back(m.first_.back() + b.bins_);
+    m.counts_.assign(DIRECTIONS * m.first_.back(), 0.0);
+    m.class_counts_.assign(DIRECTIONS, 0.0);
+    m.log_prob_.assign(DIRECTIONS * m.first_.back(), 0.0f);
+    m.log_prior_.assign(DIRECTIONS, 0.0f);
+    probabilities(m);
+    return m;
+}
+
+auto AARC::Bayes::train(Model &model, const std::vector<Feature> &features, const Feature &forward) -> size_t {
+    using namespace std;
+    MethodLogger mlog("Bayes::train");
+    if (features.size() != model.bins_.size()) {
+        mlog.logger()->error("{} features for a model of {}", features.size(), model.bins_.size());
+        return 0;
+    }
+    auto       inputs = features;
+    inputs.emplace_back(forward);
+    const auto range  = coverage(inputs);
+    const auto begin  = max(range.first, model.next_bar_), end = range.second;
+    if (begin >= end) return 0;
+
+    /* Counts per chunk in parallel, each weighted from the end of its chunk. Folding them in order, the total so far
+    decays by a chunk's length before the chunk is added */
+    const auto total  = model.first_.back();
+    const auto chunks = (end - begin + chunk - 1) / chunk;
+    auto       counts = vector<vector<double>>(chunks);
+    concurrency::parallel_for(size_t(0), chunks, [&](const size_t k) {
+        auto &     cc = counts[k];
+        const auto b0 = begin + k * chunk, b1 = min(end, b0 + chunk);
+        cc.assign((total + 1) * DIRECTIONS, 0.0);
+        auto w = 1.0;
+        for (auto bar = b1; bar-- > b0;) {
+            const auto c = direction(model, forward.values_[bar - forward.offset_]);
+            cc[total * DIRECTIONS + c] += w;
+            for (auto f = size_t(0); f < features.size(); ++f) {
+                const auto x = features[f].values_[bar - features[f].offset_];
+                cc[c * total + model.first_[f] + bin(model.bins_[f], x)] += w;
+            }
+            w *= model.decay_;
+        }
+    });
+    for (auto k = size_t(0); k < chunks; ++k) {
+        const auto bars  = min(end, begin + (k + 1) * chunk) - (begin + k * chunk);
+        const auto scale = pow(model.decay_, static_cast<double>(bars));
+        for (auto i = size_t(0); i < model.counts_.size(); ++i) {
+            model.counts_[i] = model.counts_[i] * scale + counts[k][i];
+        }
+        for (auto c = size_t(0); c < DIRECTIONS; ++c) {
+            model.class_counts_[c] = model.class_counts_[c] * scale + counts[k][total * DIRECTIONS + c];
+        }
+    }
+    probabilities(model);
+    model.next_bar_ = end;
+    return end - begin;
+}
+
+auto AARC::Bayes::score(const Model &model, const std::vector<Feature> &features) -> Scores {
+    using namespace std;
+    MethodLogger mlog("Bayes::score");
+    auto         out = Scores();
+    // No features would leave every bar covered
+    if (features.empty() || features.size() != model.bins_.size()) {
+        mlog.logger()->error("{} features for a model of {}", features.size(), model.bins_.size());
+        return out;
+    }
+    const auto range = coverage(features);
+    out.offset_      = range.first;
+    out.bars_        = range.second - range.first;
+    out.p_.resize(DIRECTIONS * out.bars_);
+    const auto n  = features.size();
+    auto       lo = vector<float>(n), inv_width = vector<float>(n);
+    auto       bins = vector<int32_t>(n), first = vector<int32_t>(n);
+    for (auto f = size_t(0); f < n; ++f) {
+        lo[f]        = model.bins_[f].lo_;
+        inv_width[f] = ::inv_width(model.bins_[f]);
+        bins[f]      = static_cast<int32_t>(model.bins_[f].bins_);
+        first[f]     = static_cast<int32_t>(model.first_[f]);
+    }
+    // Each chunk's features gathered feature-major for the kernel, then its probabilities spread back out
+    concurrency::parallel_for(size_t(0), (out.bars_ + chunk - 1) / chunk, [&](const size_t k) {
+        const auto b0 = out.offset_ + k * chunk, count = min(chunk, range.second - b0);
+        auto       values = vector<float>(n * count), p = vector<float>(DIRECTIONS * count);
+        for (auto f = size_t(0); f < n; ++f) {
+            const auto *src = features[f].values_.data() + (b0 - features[f].offset_);
+            copy(src, src + count, begin(values) + f * count);
+        }
+        ispc::bayes_scores(values.data(), count, n, lo.data(), inv_width.data(), bins.data(), first.data(),
+                           model.log_prob_.data(), model.first_.back(), model.log_prior_.data(), DIRECTIONS, p.data());
+        for (auto c = size_t(0); c < DIRECTIONS; ++c) {
+            copy(begin(p) + c * count, begin(p) + (c + 1) * count, begin(out.p_) + c * out.bars_ + k * chunk);
+        }
+    });
+    return out;
+}
+
+namespace {
+    // An indicator in [0, 100] that calls the next return correctly most of the time, and one that is noise
+    auto predictive(const size_t count, const uint64_t seed, std::vector<Feature> &features, Feature &forward) {
+        auto u = std::vector<double>(3 * count);
+        auto s = AARC::Random::Stream{seed};
+        AARC::Random::uniform(s, u.data(), u.size());
+        features = std::vector<Feature>{Feature{{}, 3}, Feature{{}, 0}};
+        forward  = Feature{{}, 3};
+        for (auto i = size_t(0); i < count; ++i) {
+            const auto x     = 100.0 * u[3 * i];
+            const auto trend = x > 70.0 ? 0.01 : x < 30.0 ? -0.01 : 0.0;
+            features[0].values_.emplace_back(float(x));
+            features[1].values_.emplace_back(float(u[3 * i + 1]));
+            forward.values_.emplace_back(float(trend + 0.008 * (u[3 * i + 2] - 0.5)));
+        }
+        features[1].values_.resize(count + 3);
+    }
+} // namespace
+
+TEST_CASE("Bayes direction") {
+    using namespace AARC::Bayes;
+    auto features = std::vector<Feature>();
+    auto forward  = Feature();
+    predictive(40000, 1, features, forward);
+    const auto bins = std::vector<Binning>{Binning{0.0f, 10.0f, 10}, binning(features[1].values_, 5)};
+    CHECK(bins[1].lo_ == doctest::Approx(0.01f).epsilon(0.2));
+    CHECK(bins[1].width_ == doctest::Approx(0.98f / 5).epsilon(0.05));
+
+    auto m = model(bins, 0.005f);
+    // Half the history now and the rest as it arrives, only the new bars are learnt
+    auto first_half = features;
+    for (auto &f : first_half) f.values_.resize(20000 + 3 - f.offset_);
+    auto forward_half = forward;
+    forward_half.values_.resize(20000);
+    CHECK(train(m, first_half, forward_half) == 20000);
+    CHECK(m.next_bar_ == 20003);
+    CHECK(train(m, features, forward) == 20000);
+    CHECK(train(m, features, forward) == 0);
+    auto once = model(bins, 0.005f);
+    train(once, features, forward);
+    CHECK(once.counts_ == m.counts_);
+    CHECK(once.class_counts_[UP] == doctest::Approx(0.3 * 40000).epsilon(0.03));
+
+    // Scored on fresh bars the indicator's calls come through
+    auto test_features = std::vector<Feature>();
+    auto test_forward  = Feature();
+    predictive(10000, 2, test_features, test_forward);
+    const auto s = score(m, test_features);
+    REQUIRE(s.offset_ == 3);
+    REQUIRE(s.bars_ == 10000);
+    auto right = size_t(0), normalised = size_t(0);
+    for (auto i = size_t(0); i < s.bars_; ++i) {
+        const auto p      = std::vector<float>{s.p_[i], s.p_[s.bars_ + i], s.p_[2 * s.bars_ + i]};
+        const auto best   = size_t(std::max_element(begin(p), end(p)) - begin(p));
+        const auto actual = test_forward.values_[i];
+        normalised += std::abs(p[0] + p[1] + p[2] - 1.0f) < 1e-5f;
+        right += best == (actual > 0.005f ? UP : actual < -0.005f ? DOWN : FLAT);
+    }
+    CHECK(normalised == s.bars_);
+    CHECK(right > 9500);
+
+    // Against the sums worked out directly for one bar
+    const auto x = test_features[0].values_[7], y = test_features[1].values_[10];
+    const auto by = std::min<size_t>(4, size_t(std::max(0.0f, (y - bins[1].lo_) * (1.0f / bins[1].width_))));
+    auto       lp = std::vector<double>(DIRECTIONS);
+    for (auto c = size_t(0); c < DIRECTIONS; ++c) {
+        lp[c] = m.log_prior_[c] + m.log_prob_[c * 15 + size_t(x / 10.0f)] + m.log_prob_[c * 15 + 10 + by];
+    }
+    const auto norm = std::exp(lp[0]) + std::exp(lp[1]) + std::exp(lp[2]);
+    CHECK(s.p_[s.bars_ + 7] == doctest::Approx(std::exp(lp[1]) / norm).epsilon(1e-4));
+
+    // With decay a model trained in two goes matches one trained in one
+    auto d1 = model(bins, 0.005f, 1.0, 0.9999), d2 = model(bins, 0.005f, 1.0, 0.9999);
+    train(d1, first_half, forward_half);
+    train(d1, features, forward);
+    train(d2, features, forward);
+    CHECK(d1.class_counts_[FLAT] == doctest::Approx(d2.class_counts_[FLAT]).epsilon(1e-9));
+    CHECK(d1.class_counts_[FLAT] < 0.5 * once.class_counts_[FLAT]);
+}
+
+TEST_CASE("Bayes bins a value the same way in training and scoring") {
+    using namespace AARC::Bayes;
+    // Multiples of 0.01 land on or next to the edges of 0.1 wide bins, odd bins only ever see falls
+    const auto b       = Binning{0.0f, 0.1f, 100};
+    auto       feature = Feature(), forward = Feature();
+    for (auto k = 0; k < 1000; ++k) {
+        feature.values_.emplace_back(k * 0.01f);
+        forward.values_.emplace_back(bin(b, k * 0.01f) % 2 ? -0.01f : 0.01f);
+    }
+    auto m = model({b}, 0.001f, 0.01);
+    CHECK(train(m, {feature}, forward) == 1000);
+    const auto s = score(m, {feature});
+    REQUIRE(s.bars_ == 1000);
+    auto right = size_t(0);
+    for (auto i = size_t(0); i < s.bars_; ++i) right += (s.p_[UP * s.bars_ + i] > 0.5f) == (forward.values_[i] > 0.0f);
+    CHECK(right == 1000);
+    CHECK(score(model({}, 0.001f), {}).p_.empty());
+}
+
+TEST_CASE("Bayes on TA features") {
+    using namespace AARC::Bayes;
+    const auto bars = AARC::Random::walk(5000, 6);
+    // TA outputs end at the last bar
+    const auto rsi   = AARC::TA::rsi(bars.close_, 14);
+    const auto stoch = AARC::TA::stoch(bars, 14, 3);
+    const auto fwd   = AARC::TA::period_returns(bars, 5, AARC::TA::PeriodReturnType::CLOSECLOSE);
+    const auto n        = bars.ts_.size();
+    const auto features = std::vector<Feature>{Feature{rsi, n - rsi.size()}, Feature{stoch.k_, n - stoch.k_.size()}};
+    auto m = model({Binning{0.0f, 10.0f, 10}, Binning{0.0f, 10.0f, 10}}, 0.002f);
+    CHECK(train(m, features, Feature{fwd, 0}) == fwd.size() - features[0].offset_);
+    const auto sc = score(m, features);
+    CHECK(sc.offset_ == features[0].offset_);
+    CHECK(sc.offset_ + sc.bars_ == bars.ts_.size());
+    // A random walk has nothing to find, the scores stay near the priors
+    const auto prior_up = std::exp(m.log_prior_[UP]);
+    CHECK(sc.p_[2 * sc.bars_ + 100] == doctest::Approx(prior_up).epsilon(0.3));
+}
+
+TEST_CASE("Bayes benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::Bayes;
+    using namespace std::chrono;
+    auto features = std::vector<Feature>();
+    auto forward  = Feature();
+    predictive(1000000, 3, features, forward);
+    features.emplace_back(features[0]);
+    features.emplace_back(features[1]);
+    auto m = model({Binning{0.0f, 10.0f, 10}, binning(features[1].values_, 8), Binning{0.0f, 5.0f, 20},
+                    binning(features[1].values_, 16)},
+                   0.005f);
+    auto start = high_resolution_clock::now();
+    train(m, features, forward);
+    const auto train_us = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    start               = high_resolution_clock::now();
+    const auto s        = score(m, features);
+    const auto score_us = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    CHECK(s.bars_ == 1000000);
+    spdlog::get("logger")->info("Bayes 4 features x 1m bars train {}us, score {}us", train_us, score_us);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "Features.h"
+#include <cstdint>
+#include <vector>
+
+namespace AARC {
+    namespace Bayes {
+        /* Naive Bayes classifier of the direction of the forward return from TA features. Each feature is binned,
+        training counts how often each bin comes up before a fall, a flat period or a rise, and scoring adds up the
+        log probabilities of a bar's bins for each direction. Training is incremental, appending bars to the inputs and
+        training again only learns the new bars, and older bars can be made to count less with decay */
+
+        enum Direction { DOWN, FLAT, UP, DIRECTIONS };
+
+        // values_[i] is the value at bar offset_ + i, TA outputs start once their window is full
+        using Feature = Features::Column;
+
+        // Equal width bins from lo_, values outside go in the end bins
+        struct Binning {
+            float  lo_    = 0.0f;
+            float  width_ = 1.0f;
+            size_t bins_  = 10;
+        };
+
+        // Bins spanning the 1st to 99th percentile of the values, so a few outliers don't leave most bins empty
+        auto binning(const std::vector<float> &values, const size_t bins) -> Binning;
+
+        struct Model {
+            std::vector<Binning> bins_;            // One per feature, in the order the features are passed
+            float                flat_     = 0.0f; // Forward returns within +/- flat_ are FLAT
+            double               alpha_    = 1.0;  // Laplace smoothing, added to every count
+            double               decay_    = 1.0;  // A bar's weight is decay_^(bars learnt since), 1 for equal
+            size_t               next_bar_ = 0;    // First bar not learnt yet
+            std::vector<size_t>  first_;           // Feature f's bins start at first_[f], first_.back() is the total
+            std::vector<double>  counts_;          // counts_[c * first_.back() + first_[f] + b], weighted
+            std::vector<double>  class_counts_;
+            std::vector<float>   log_prob_;        // log P(bin | class) laid out as counts_
+            std::vector<float>   log_prior_;
+        };
+
+        auto model(const std::vector<Binning> &bins, const float flat, const double alpha = 1.0,
+                   const double decay = 1.0) -> Model;
+
+        /* Learns the bars from next_bar_ that every feature and the forward return (TA::period_returns, the return
+         * from that bar) cover, returns how many */
+        auto train(Model &model, const std::vector<Feature> &features, const Feature &forward) -> size_t;
+
+        // p_[c * bars_ + i] is the probability of direction c from bar offset_ + i
+        struct Scores {
+            size_t             offset_ = 0;
+            size_t             bars_   = 0;
+            std::vector<float> p_;
+        };
+
+        // Every bar all the features cover
+        auto score(const Model &model, const std::vector<Feature> &features) -> Scores;
+    } // namespace Bayes
+} // namespace AARC
@@ -0,0 +1,122 @@
+#include "BlackScholes.h"
+#include "Split.h"
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+namespace {
+    auto norm_cdf(const double x) { return 0.5 * std::erfc(-x / std::sqrt(2.0)); }
+} // namespace
+
+auto AARC::BlackScholes::add(Chain &chain, const float spot, const float strike, const float vol, const float rate,
+                             const float dividend, const float expiry, const bool call) -> void {
+    chain.spot_.emplace_back(spot);
+    chain.strike_.emplace_back(strike);
+    chain.vol_.emplace_back(vol);
+    chain.rate_.emplace_back(rate);
+    chain.dividend_.emplace_back(dividend);
+    chain.expiry_.emplace_back(expiry);
+    chain.call_.emplace_back(call ? 1 : 0);
+}
+
+auto AARC::BlackScholes::price(const Chain &chain) -> Greeks {
+    auto out = Greeks();
+    price(chain, out);
+    return out;
+}
+
+auto AARC::BlackScholes::price(const Chain &chain, Greeks &out) -> void {
+    const auto sz = chain.spot_.size();
+    for (auto *v : {&out.price_, &out.delta_, &out.gamma_, &out.vega_, &out.theta_, &out.rho_}) v->resize(sz);
+    // Big chains are split across cores, each piece is one kernel call
+    const auto chunk = size_t(16384);
+    concurrency::parallel_for(size_t(0), (sz + chunk - 1) / chunk, [&](const size_t c) {
+        const auto i = c * chunk;
+        ispc::black_scholes(chain.spot_.data() + i, chain.strike_.data() + i, chain.vol_.data() + i,
+                            chain.rate_.data() + i, chain.dividend_.data() + i, chain.expiry_.data() + i,
+                            chain.call_.data() + i, out.price_.data() + i, out.delta_.data() + i,
+                            out.gamma_.data() + i, out.vega_.data() + i, out.theta_.data() + i, out.rho_.data() + i,
+                            std::min(chunk, sz - i));
+    });
+}
+
+auto AARC::BlackScholes::value(const double spot, const double strike, const double vol, const double rate,
+                               const double dividend, const double expiry, const bool call) -> double {
+    using namespace std;
+    const auto sign = call ? 1.0 : -1.0;
+    if (expiry <= 0.0 || vol <= 0.0) return max(sign * (spot - strike), 0.0);
+    const auto sd = vol * sqrt(expiry);
+    const auto d1 = (log(spot / strike) + (rate - dividend) * expiry) / sd + 0.5 * sd;
+    return sign * (spot * exp(-dividend * expiry) * norm_cdf(sign * d1) -
+                   strike * exp(-rate * expiry) * norm_cdf(sign * (d1 - sd)));
+}
+
+auto AARC::BlackScholes::vega(const double spot, const double strike, const double vol, const double rate,
+                              const double dividend, const double expiry) -> double {
+    using namespace std;
+    if (expiry <= 0.0 || vol <= 0.0) return 0.0;
+    const auto sd = vol * sqrt(expiry);
+    const auto d1 = (log(spot / strike) + (rate - dividend) * expiry) / sd + 0.5 * sd;
+    return spot * exp(-dividend * expiry) * exp(-0.5 * d1 * d1) / sqrt(2.0 * 3.14159265358979323846) * sqrt(expiry);
+}
+
+TEST_CASE("Black-Scholes chain") {
+    using namespace AARC::BlackScholes;
+    auto chain = Chain();
+    for (auto i = 0; i < 1000; ++i) {
+        add(chain, 100.0f, 50.0f + i % 100, 0.1f + 0.01f * (i % 40), 0.03f, 0.01f * (i % 3),
+            0.05f + 0.01f * (i % 200), i % 2 == 0);
+    }
+    add(chain, 100.0f, 90.0f, 0.2f, 0.03f, 0.0f, 0.0f, true);
+    const auto g = price(chain);
+    REQUIRE(g.price_.size() == chain.spot_.size());
+    for (auto i = size_t(0); i < chain.spot_.size(); ++i) {
+        const auto s = double(chain.spot_[i]), k = double(chain.strike_[i]), v = double(chain.vol_[i]);
+        const auto r = double(chain.rate_[i]), q = double(chain.dividend_[i]), t = double(chain.expiry_[i]);
+        const bool c = chain.call_[i] != 0;
+        const auto bump = [&](const double ds, const double dv, const double dr, const double dt) {
+            return value(s + ds, k, v + dv, r + dr, q, t + dt, c);
+        };
+        CHECK(g.price_[i] == doctest::Approx(value(s, k, v, r, q, t, c)).epsilon(1e-4).scale(1.0));
+        if (t <= 0.0) {
+            CHECK(g.price_[i] == doctest::Approx(10.0));
+            CHECK(g.gamma_[i] == 0.0f);
+            continue;
+        }
+        // Greeks against central differences of the double precision price
+        const auto h = 1e-3;
+        CHECK(g.delta_[i] == doctest::Approx((bump(h, 0, 0, 0) - bump(-h, 0, 0, 0)) / (2 * h)).epsilon(1e-3).scale(1.0));
+        CHECK(g.gamma_[i] ==
+              doctest::Approx((bump(h, 0, 0, 0) - 2 * bump(0, 0, 0, 0) + bump(-h, 0, 0, 0)) / (h * h))
+                  .epsilon(1e-2)
+                  .scale(1.0));
+        CHECK(g.vega_[i] == doctest::Approx((bump(0, h, 0, 0) - bump(0, -h, 0, 0)) / (2 * h)).epsilon(1e-3).scale(1.0));
+        CHECK(g.vega_[i] == doctest::Approx(vega(s, k, v, r, q, t)).epsilon(1e-3).scale(1.0));
+        CHECK(g.rho_[i] == doctest::Approx((bump(0, 0, h, 0) - bump(0, 0, -h, 0)) / (2 * h)).epsilon(1e-3).scale(1.0));
+        // Theta is the decay as calendar time passes, expiry getting shorter
+        CHECK(g.theta_[i] ==
+              doctest::Approx(-(bump(0, 0, 0, h) - bump(0, 0, 0, -h)) / (2 * h)).epsilon(1e-3).scale(1.0));
+    }
+}
+
+TEST_CASE("Black-Scholes benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::BlackScholes;
+    using namespace std::chrono;
+    auto chain = Chain();
+    for (auto i = 0; i < 1000000; ++i) {
+        add(chain, 100.0f, 50.0f + i % 100, 0.1f + 0.01f * (i % 40), 0.03f, 0.0f, 0.05f + 0.01f * (i % 200),
+            i % 2 == 0);
+    }
+    auto greeks = price(chain);
+    // Sliders moving, the same buffers are reused every frame
+    const auto start = high_resolution_clock::now();
+    for (auto frame = 0; frame < 10; ++frame) {
+        for (auto &s : chain.spot_) s += 0.01f;
+        price(chain, greeks);
+    }
+    const auto us = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    CHECK(greeks.price_.size() == chain.spot_.size());
+    spdlog::get("logger")->info("Black-Scholes 1m options with Greeks {}us per chain", us / 10);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace AARC {
+    namespace BlackScholes {
+        /* Option chain in SoA layout so a whole chain can be repriced in one vectorised pass, e.g. every frame while
+         * spot/vol/rate sliders are moving. call_ is 1 for a call and 0 for a put, expiry_ in years */
+        struct Chain {
+            std::vector<float>  spot_;
+            std::vector<float>  strike_;
+            std::vector<float>  vol_;
+            std::vector<float>  rate_;
+            std::vector<float>  dividend_;
+            std::vector<float>  expiry_;
+            std::vector<int8_t> call_;
+        };
+
+        // Vega and rho per unit (1.0 = 100%) of vol and rate, theta per year
+        struct Greeks {
+            std::vector<float> price_;
+            std::vector<float> delta_;
+            std::vector<float> gamma_;
+            std::vector<float> vega_;
+            std::vector<float> theta_;
+            std::vector<float> rho_;
+        };
+
+        auto add(Chain &chain, const float spot, const float strike, const float vol, const float rate,
+                 const float dividend, const float expiry, const bool call) -> void;
+
+        auto price(const Chain &chain) -> Greeks;
+        // Reuses out's buffers, nothing is allocated once they are the size of the chain
+        auto price(const Chain &chain, Greeks &out) -> void;
+
+        // Single option in double precision, for solvers and control variates that need more than float
+        auto value(const double spot, const double strike, const double vol, const double rate, const double dividend,
+                   const double expiry, const bool call) -> double;
+        auto vega(const double spot, const double strike, const double vol, const double rate, const double dividend,
+                  const double expiry) -> double;
+    } // namespace BlackScholes
+} // namespace AARC
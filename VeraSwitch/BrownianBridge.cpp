@@ -0,0 +1,91 @@
+#include "BrownianBridge.h"
+#include "Random.h"
+#include "Split.h"
+#include <algorithm>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <numeric>
+
+auto AARC::BrownianBridge::build(const std::vector<double> &times) -> Bridge {
+    using namespace std;
+    const auto n = times.size();
+    auto       b = Bridge{n,
+                    vector<int64_t>(n),
+                    vector<int64_t>(n),
+                    vector<int64_t>(n),
+                    vector<double>(n),
+                    vector<double>(n),
+                    vector<double>(n),
+                    vector<double>(n)};
+    if (n == 0) return b;
+    for (auto i = size_t(0); i < n; ++i) b.sqrt_dt_[i] = sqrt(times[i] - (i == 0 ? 0.0 : times[i - 1]));
+
+    // Which normal fills each time point, 0 for not yet filled
+    auto filled        = vector<size_t>(n);
+    filled[n - 1]      = 1;
+    b.bridge_index_[0] = static_cast<int64_t>(n - 1);
+    b.stddev_[0]       = sqrt(times[n - 1]);
+    for (auto i = size_t(1), j = size_t(0); i < n; ++i) {
+        // Next gap [j, k) between filled points, bisected
+        while (filled[j]) ++j;
+        auto k = j;
+        while (!filled[k]) ++k;
+        const auto l = j + ((k - 1 - j) >> 1);
+        filled[l]    = i;
+
+        const auto t_left  = j == 0 ? 0.0 : times[j - 1];
+        b.bridge_index_[i] = static_cast<int64_t>(l);
+        b.left_index_[i]   = static_cast<int64_t>(j);
+        b.right_index_[i]  = static_cast<int64_t>(k);
+        b.left_weight_[i]  = (times[k] - times[l]) / (times[k] - t_left);
+        b.right_weight_[i] = (times[l] - t_left) / (times[k] - t_left);
+        b.stddev_[i]       = sqrt((times[l] - t_left) * (times[k] - times[l]) / (times[k] - t_left));
+        j                  = k + 1;
+        if (j >= n) j = 0;
+    }
+    return b;
+}
+
+auto AARC::BrownianBridge::build(const size_t steps, const double expiry) -> Bridge {
+    auto times = std::vector<double>(steps);
+    for (auto i = size_t(0); i < steps; ++i) times[i] = expiry * (i + 1) / steps;
+    return build(times);
+}
+
+auto AARC::BrownianBridge::increments(const Bridge &bridge, const double *normals, double *z, const size_t count)
+    -> void {
+    if (bridge.steps_ == 0) return;
+    ispc::brownian_bridge(normals, z, count, bridge.steps_, bridge.bridge_index_.data(), bridge.left_index_.data(),
+                          bridge.right_index_.data(), bridge.left_weight_.data(), bridge.right_weight_.data(),
+                          bridge.stddev_.data(), bridge.sqrt_dt_.data());
+}
+
+TEST_CASE("Brownian bridge") {
+    using namespace AARC::BrownianBridge;
+    const auto times  = std::vector<double>{0.1, 0.25, 0.3, 0.5, 0.8, 0.85, 1.0};
+    const auto bridge = build(times);
+    const auto steps  = times.size();
+    // Every point is filled exactly once
+    auto order = bridge.bridge_index_;
+    std::sort(begin(order), end(order));
+    for (auto i = size_t(0); i < steps; ++i) CHECK(order[i] == static_cast<int64_t>(i));
+
+    // Built from independent normals the increments are independent standard normals again
+    const auto count   = size_t(200000);
+    auto       normals = std::vector<double>(count * steps);
+    auto       stream  = AARC::Random::Stream{11};
+    AARC::Random::normal(stream, normals.data(), normals.size());
+    auto z = std::vector<double>(count * steps);
+    increments(bridge, normals.data(), z.data(), count);
+    for (auto a = size_t(0); a < steps; ++a) {
+        for (auto b = a; b < steps; ++b) {
+            auto cov = 0.0;
+            for (auto p = size_t(0); p < count; ++p) cov += z[a * count + p] * z[b * count + p];
+            CHECK(cov / count == doctest::Approx(a == b ? 1.0 : 0.0).epsilon(0.02).scale(1.0));
+        }
+    }
+    // The first normal alone fixes where the path ends
+    auto w_end = 0.0;
+    for (auto i = size_t(0); i < steps; ++i) w_end += z[i * count] * bridge.sqrt_dt_[i];
+    CHECK(w_end == doctest::Approx(normals[0] * std::sqrt(times.back())));
+}
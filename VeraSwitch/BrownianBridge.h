@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace AARC {
+    namespace BrownianBridge {
+        /* Brownian bridge construction of a path. The first normal sets where the path ends, the next its midpoint
+        given both ends, then the midpoints of the two halves and so on, so most of a path's variance comes from the
+        first few normals. Feeding it Sobol points puts the best distributed dimensions on the increments that matter
+        most for path dependent payoffs */
+        struct Bridge {
+            size_t               steps_ = 0;
+            std::vector<int64_t> bridge_index_; // Time point the i'th normal fills in
+            std::vector<int64_t> left_index_;   // One past the point to its left, 0 is the start of the path
+            std::vector<int64_t> right_index_;  // The point to its right
+            std::vector<double>  left_weight_;
+            std::vector<double>  right_weight_;
+            std::vector<double>  stddev_;
+            std::vector<double>  sqrt_dt_;
+        };
+
+        // Bridge over increasing times t_1 ... t_n after a start at 0
+        auto build(const std::vector<double> &times) -> Bridge;
+        // Evenly spaced steps up to expiry
+        auto build(const size_t steps, const double expiry) -> Bridge;
+
+        /* count x steps normals, each path's in bridge order, to the steps x count standard normal increments
+         * MonteCarlo's path kernel takes. z is written in place so a block needs no extra storage */
+        auto increments(const Bridge &bridge, const double *normals, double *z, const size_t count) -> void;
+    } // namespace BrownianBridge
+} // namespace AARC
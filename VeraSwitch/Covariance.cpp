@@ -0,0 +1,259 @@
+#include "Covariance.h"
+#include "Random.h"
+#include "Split.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+namespace {
+    using namespace AARC::Covariance;
+
+    // Assets per side of an output tile, 64 x 64 doubles fit in L2 next to the row being streamed
+    constexpr size_t tile = 64;
+
+    /* Weighted co-moments of the rows about the weighted mean, sum of w[t] (x[t] - m)(x[t] - m)'. Each lower
+     * triangle tile is one task */
+    auto comoments(const double *rows, const size_t count, const size_t n, const std::vector<double> &weight)
+        -> Matrix {
+        using namespace std;
+        auto out   = Matrix{n, vector<double>(n, 0.0), vector<double>(n * n, 0.0)};
+        auto total = 0.0;
+        for (auto t = size_t(0); t < count; ++t) {
+            total += weight[t];
+            for (auto a = size_t(0); a < n; ++a) out.mean_[a] += weight[t] * rows[t * n + a];
+        }
+        for (auto &m : out.mean_) m /= total;
+        auto centred = vector<double>(count * n);
+        for (auto t = size_t(0); t < count; ++t) {
+            for (auto a = size_t(0); a < n; ++a) centred[t * n + a] = rows[t * n + a] - out.mean_[a];
+        }
+        const auto tiles = (n + tile - 1) / tile;
+        concurrency::parallel_for(size_t(0), tiles * (tiles + 1) / 2, [&](const size_t k) {
+            auto ti = size_t(0);
+            while ((ti + 1) * (ti + 2) / 2 <= k) ++ti;
+            const auto tj = k - ti * (ti + 1) / 2;
+            ispc::syrk_tile(centred.data(), weight.data(), out.cov_.data(), count, n, ti * tile,
+                            min(n, (ti + 1) * tile), tj * tile, min(n, (tj + 1) * tile));
+        });
+        return out;
+    }
+
+    auto mirror(Matrix &m, const double scale) -> void {
+        const auto n = m.assets_;
+        for (auto i = size_t(0); i < n; ++i) {
+            for (auto j = size_t(0); j <= i; ++j) m.cov_[i * n + j] = m.cov_[j * n + i] = m.cov_[i * n + j] * scale;
+        }
+    }
+
+    auto rows_of(const AARC::VaR::Returns &returns) { return returns.r_.data(); }
+} // namespace
+
+auto AARC::Covariance::sample(const double *rows, const size_t count, const size_t assets) -> Matrix {
+    if (count < 2) return Matrix{assets, std::vector<double>(assets), std::vector<double>(assets * assets)};
+    auto out = comoments(rows, count, assets, std::vector<double>(count, 1.0));
+    mirror(out, 1.0 / (count - 1));
+    return out;
+}
+
+auto AARC::Covariance::sample(const VaR::Returns &returns) -> Matrix {
+    return sample(rows_of(returns), returns.ts_.size(), returns.assets_.size());
+}
+
+auto AARC::Covariance::ewma(const double *rows, const size_t count, const size_t assets, const double decay)
+    -> Matrix {
+    using namespace std;
+    if (count == 0) return Matrix{assets, vector<double>(assets), vector<double>(assets * assets)};
+    auto weight = vector<double>(count);
+    auto total  = 0.0;
+    for (auto t = count; t-- > 0;) {
+        weight[t] = t + 1 == count ? 1.0 - decay : weight[t + 1] * decay;
+        total += weight[t];
+    }
+    for (auto &w : weight) w /= total;
+    auto out = comoments(rows, count, assets, weight);
+    mirror(out, 1.0);
+    return out;
+}
+
+auto AARC::Covariance::ewma(const VaR::Returns &returns, const double decay) -> Matrix {
+    return ewma(rows_of(returns), returns.ts_.size(), returns.assets_.size(), decay);
+}
+
+auto AARC::Covariance::ledoit_wolf(const double *rows, const size_t count, const size_t assets) -> Matrix {
+    using namespace std;
+    const auto n = assets;
+    if (count < 2) return sample(rows, count, assets);
+    // Their estimator works with the 1 / T sample covariance
+    auto s = comoments(rows, count, n, vector<double>(count, 1.0));
+    mirror(s, 1.0 / count);
+    auto mu = 0.0;
+    for (auto i = size_t(0); i < n; ++i) mu += s.cov_[i * n + i] / n;
+    // Distance of the sample from the target, and how far each row's outer product strays from the sample
+    auto d2 = 0.0;
+    for (auto i = size_t(0); i < n; ++i) {
+        for (auto j = size_t(0); j < n; ++j) {
+            const auto e = s.cov_[i * n + j] - (i == j ? mu : 0.0);
+            d2 += e * e / n;
+        }
+    }
+    auto s_norm = 0.0;
+    for (const auto v : s.cov_) s_norm += v * v;
+    auto       spread = vector<double>(count);
+    const auto chunk  = size_t(256);
+    concurrency::parallel_for(size_t(0), (count + chunk - 1) / chunk, [&](const size_t c) {
+        auto x = vector<double>(n);
+        for (auto t = c * chunk; t < min(count, (c + 1) * chunk); ++t) {
+            for (auto a = size_t(0); a < n; ++a) x[a] = rows[t * n + a] - s.mean_[a];
+            // ||x x' - S||^2 = ||x||^4 - 2 x'Sx + ||S||^2
+            auto xx = 0.0, xsx = 0.0;
+            for (auto i = size_t(0); i < n; ++i) {
+                xx += x[i] * x[i];
+                auto sx = 0.0;
+                for (auto j = size_t(0); j < n; ++j) sx += s.cov_[i * n + j] * x[j];
+                xsx += x[i] * sx;
+            }
+            spread[t] = xx * xx - 2.0 * xsx + s_norm;
+        }
+    });
+    auto b2 = 0.0;
+    for (const auto v : spread) b2 += v / n;
+    b2 = min(b2 / (double(count) * count), d2);
+    const auto shrink = d2 > 0.0 ? b2 / d2 : 0.0;
+    for (auto i = size_t(0); i < n; ++i) {
+        for (auto j = size_t(0); j < n; ++j) {
+            s.cov_[i * n + j] = (1.0 - shrink) * s.cov_[i * n + j] + (i == j ? shrink * mu : 0.0);
+        }
+    }
+    s.shrinkage_ = shrink;
+    return s;
+}
+
+auto AARC::Covariance::ledoit_wolf(const VaR::Returns &returns) -> Matrix {
+    return ledoit_wolf(rows_of(returns), returns.ts_.size(), returns.assets_.size());
+}
+
+auto AARC::Covariance::accumulator(const size_t assets, const double decay) -> Accumulator {
+    return Accumulator{assets, decay, 0, std::vector<double>(assets, 0.0), std::vector<double>(assets * assets, 0.0),
+                       std::vector<double>(assets)};
+}
+
+auto AARC::Covariance::add(Accumulator &acc, const double *row) -> void {
+    const auto n = acc.assets_;
+    ++acc.count_;
+    for (auto a = size_t(0); a < n; ++a) acc.delta_[a] = row[a] - acc.mean_[a];
+    if (acc.decay_ <= 0.0 || acc.count_ == 1) {
+        // Welford, M += (n - 1) / n d d' with d taken from the old mean
+        const auto scale = double(acc.count_ - 1) / acc.count_;
+        for (auto a = size_t(0); a < n; ++a) acc.mean_[a] += acc.delta_[a] / acc.count_;
+        if (acc.decay_ <= 0.0) {
+            ispc::rank_one_update(acc.moment_.data(), acc.delta_.data(), n, scale);
+        }
+        return;
+    }
+    // Exponentially weighted, S = decay (S + (1 - decay) d d') and the mean moves (1 - decay) of the way
+    const auto w = 1.0 - acc.decay_;
+    for (auto a = size_t(0); a < n; ++a) acc.mean_[a] += w * acc.delta_[a];
+    ispc::rank_one_update(acc.moment_.data(), acc.delta_.data(), n, w);
+    for (auto i = size_t(0); i < n; ++i) {
+        for (auto j = size_t(0); j <= i; ++j) acc.moment_[i * n + j] *= acc.decay_;
+    }
+}
+
+auto AARC::Covariance::matrix(const Accumulator &acc) -> Matrix {
+    auto out = Matrix{acc.assets_, acc.mean_, acc.moment_};
+    if (acc.decay_ <= 0.0) mirror(out, acc.count_ > 1 ? 1.0 / (acc.count_ - 1) : 0.0);
+    else mirror(out, 1.0);
+    return out;
+}
+
+auto AARC::Covariance::correlation(const Matrix &m) -> std::vector<double> {
+    const auto n   = m.assets_;
+    auto       out = std::vector<double>(n * n, 0.0);
+    for (auto i = size_t(0); i < n; ++i) {
+        for (auto j = size_t(0); j < n; ++j) {
+            const auto d = std::sqrt(m.cov_[i * n + i] * m.cov_[j * n + j]);
+            out[i * n + j] = d > 0.0 ? m.cov_[i * n + j] / d : (i == j ? 1.0 : 0.0);
+        }
+    }
+    return out;
+}
+
+namespace {
+    // Rows of normal returns with vol 1% and correlation rho between every pair of assets
+    auto correlated(const size_t assets, const size_t count, const double rho) -> std::vector<double> {
+        auto z = std::vector<double>(count * (assets + 1));
+        auto s = AARC::Random::Stream{5};
+        AARC::Random::normal(s, z.data(), z.size());
+        auto rows = std::vector<double>(count * assets);
+        for (auto t = size_t(0); t < count; ++t) {
+            for (auto a = size_t(0); a < assets; ++a) {
+                rows[t * assets + a] = 0.01 * (std::sqrt(rho) * z[t * (assets + 1)] +
+                                               std::sqrt(1.0 - rho) * z[t * (assets + 1) + 1 + a]);
+            }
+        }
+        return rows;
+    }
+} // namespace
+
+TEST_CASE("Covariance estimates") {
+    using namespace AARC::Covariance;
+    const auto n = size_t(70), count = size_t(3000);
+    const auto rows = correlated(n, count, 0.4);
+    const auto s    = sample(rows.data(), count, n);
+    // Straight sums to compare the tiles against
+    for (const auto ij : {std::make_pair(0, 0), std::make_pair(69, 3), std::make_pair(64, 63), std::make_pair(5, 66)}) {
+        const auto i = size_t(ij.first), j = size_t(ij.second);
+        auto       c = 0.0;
+        for (auto t = size_t(0); t < count; ++t) c += (rows[t * n + i] - s.mean_[i]) * (rows[t * n + j] - s.mean_[j]);
+        CHECK(s.cov_[i * n + j] == doctest::Approx(c / (count - 1)).epsilon(1e-12));
+    }
+    const auto corr = correlation(s);
+    CHECK(corr[3 * n + 3] == doctest::Approx(1.0));
+    CHECK(corr[3 * n + 40] == doctest::Approx(0.4).epsilon(0.1));
+
+    // A row at a time gives the batch answer
+    auto acc = accumulator(n);
+    for (auto t = size_t(0); t < count; ++t) add(acc, rows.data() + t * n);
+    const auto inc = matrix(acc);
+    for (auto k = size_t(0); k < n * n; k += 97) CHECK(inc.cov_[k] == doctest::Approx(s.cov_[k]).epsilon(1e-9));
+
+    // The EWMA recursion seeded on the first row weights rows as the batch does, apart from the seed's weight
+    const auto e    = ewma(rows.data(), count, n, 0.97);
+    auto       eacc = accumulator(n, 0.97);
+    for (auto t = size_t(0); t < count; ++t) add(eacc, rows.data() + t * n);
+    const auto einc = matrix(eacc);
+    for (auto k = size_t(0); k < n * n; k += 97) CHECK(einc.cov_[k] == doctest::Approx(e.cov_[k]).epsilon(0.02));
+    // It follows a change in vol far faster than the sample covariance
+    auto shifted = rows;
+    for (auto t = count - 100; t < count; ++t) {
+        for (auto a = size_t(0); a < n; ++a) shifted[t * n + a] *= 3.0;
+    }
+    CHECK(ewma(shifted.data(), count, n, 0.97).cov_[0] > 4.0 * sample(shifted.data(), count, n).cov_[0]);
+
+    // With fewer rows than assets the sample is singular, shrinkage pulls it towards a well conditioned target
+    const auto short_rows = correlated(n, 40, 0.0);
+    const auto lw         = ledoit_wolf(short_rows.data(), 40, n);
+    CHECK(lw.shrinkage_ > 0.3);
+    CHECK(lw.shrinkage_ <= 1.0);
+    CHECK(ledoit_wolf(rows.data(), count, n).shrinkage_ < lw.shrinkage_);
+}
+
+TEST_CASE("Covariance benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::Covariance;
+    using namespace std::chrono;
+    const auto n = size_t(500), count = size_t(2500);
+    const auto rows  = correlated(n, count, 0.3);
+    auto       start = high_resolution_clock::now();
+    const auto s     = sample(rows.data(), count, n);
+    const auto us    = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    auto       acc   = accumulator(n, 0.94);
+    add(acc, rows.data());
+    start = high_resolution_clock::now();
+    add(acc, rows.data() + n);
+    const auto add_us = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    CHECK(s.cov_.size() == n * n);
+    spdlog::get("logger")->info("Covariance 500 assets x 2500 days {}us, one new day {}us", us, add_us);
+}
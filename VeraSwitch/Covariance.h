@@ -0,0 +1,49 @@
+#pragma once
+#include "VaR.h"
+#include <cstdint>
+#include <vector>
+
+namespace AARC {
+    namespace Covariance {
+        /* Covariance of many assets' returns. Rows are aligned returns (VaR::returns lines series up on their
+        timestamps), row-major with one column per asset. The batch estimates run a cache blocked syrk over tiles
+        of the matrix in parallel, the accumulator takes one new row at a time for a live update */
+
+        struct Matrix {
+            size_t              assets_ = 0;
+            std::vector<double> mean_;
+            std::vector<double> cov_;            // cov_[i * assets_ + j], symmetric
+            double              shrinkage_ = 0.0; // Weight on the target, Ledoit-Wolf only
+        };
+
+        // Equally weighted, unbiased
+        auto sample(const double *rows, const size_t count, const size_t assets) -> Matrix;
+        auto sample(const VaR::Returns &returns) -> Matrix;
+
+        // Exponentially weighted, the latest row weighted most, weights (1 - decay) * decay^age normalised
+        auto ewma(const double *rows, const size_t count, const size_t assets, const double decay = 0.94) -> Matrix;
+        auto ewma(const VaR::Returns &returns, const double decay = 0.94) -> Matrix;
+
+        /* Ledoit and Wolf's shrinkage towards a multiple of the identity (A well-conditioned estimator for
+         * large-dimensional covariance matrices, 2004), for more assets than the history can pin down */
+        auto ledoit_wolf(const double *rows, const size_t count, const size_t assets) -> Matrix;
+        auto ledoit_wolf(const VaR::Returns &returns) -> Matrix;
+
+        /* Running estimate updated a row at a time in O(assets^2). decay_ 0 keeps equal weights (Welford), otherwise
+         * each new row takes 1 - decay_ of the weight */
+        struct Accumulator {
+            size_t              assets_ = 0;
+            double              decay_  = 0.0;
+            size_t              count_  = 0;
+            std::vector<double> mean_;
+            std::vector<double> moment_; // Lower triangle of the co-moment (or EW covariance)
+            std::vector<double> delta_;
+        };
+
+        auto accumulator(const size_t assets, const double decay = 0.0) -> Accumulator;
+        auto add(Accumulator &acc, const double *row) -> void;
+        auto matrix(const Accumulator &acc) -> Matrix;
+
+        auto correlation(const Matrix &m) -> std::vector<double>;
+    } // namespace Covariance
+} // namespace AARC
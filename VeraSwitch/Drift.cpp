@@ -1,77 +1,59 @@
 #include "Drift.h"
+#include "Features.h"
 #include "TechnicalAnalysis.h"
 #include "TimeSeriesCSVFactory.h"
 #include "Utilities.h"
+#include <algorithm>
 #include <doctest\doctest.h>
+#include <functional>
 #include <spdlog\spdlog.h>
 
-/* When RSI > upper_threshold, find the return after N periods, bucket into 20 buckets */
-auto AARC::Drift::pr_rsi_short(const TSData &in, const std::vector<float> &rsi,
-                               const std::vector<float> &period_returns, const float upper_threshold)
-    -> std::vector<size_t> {
-    MethodLogger mlog("Drift::pr_rsi_short");
-
-    using namespace std;
-    const auto &max_idx       = rsi.size() - (in.ts_.size() - period_returns.size());
-    const auto &rsi_pr_offset = period_returns.size() - rsi.size();
+namespace {
+    /* Histogram of the period return following the first bar of each run of RSI past the threshold. The panel lines
+    RSI up with the return starting on the same bar, both end where the returns run out */
+    auto pr_rsi(const AARC::TSData &in, const std::vector<float> &rsi, const std::vector<float> &period_returns,
+                const std::function<bool(float)> &signal, MethodLogger &mlog) -> std::vector<size_t> {
+        using namespace std;
+        using namespace AARC::Features;
+        if (rsi.size() > in.ts_.size() || period_returns.size() > in.ts_.size()) {
+            mlog.logger()->error("{} RSI and {} returns over {} bars", rsi.size(), period_returns.size(),
+                                 in.ts_.size());
+            return vector<size_t>();
+        }
+        const auto &panel = align({trailing(rsi, in.ts_.size()), Column{period_returns, 0}}, in.ts_);
+        const auto  rows  = panel.matrix_.rows_;
+        const auto *r     = panel.matrix_.x_.data();
+        const auto *pr    = r + rows;
 
-    // Find positions of RSI where they go above upper_threshold
-    const auto &rsi_upper_positions = [&rsi, &max_idx, &rsi_pr_offset, &upper_threshold, &in]() {
-        vector<size_t> res;
-        for (auto &&i = size_t(0); i < max_idx;) {
-            if (rsi[i] > upper_threshold) {
-                res.emplace_back(i + rsi_pr_offset);
-                while (i < max_idx && rsi[i] > upper_threshold) ++i;
+        vector<float> signal_returns;
+        for (auto i = size_t(0); i < rows;) {
+            if (signal(r[i])) {
+                signal_returns.emplace_back(pr[i]);
+                while (i < rows && signal(r[i])) ++i;
             }
             ++i;
         }
-        return res;
-    }();
 
-    const auto &signal_returns = [&rsi_upper_positions, &period_returns, &mlog]() {
-        vector<float> signal_returns;
-        for (auto &&pos : rsi_upper_positions) { signal_returns.emplace_back(period_returns[pos]); }
-        return signal_returns;
-    }();
+        // Minmax
+        const auto &mm_it = minmax_element(begin(signal_returns), end(signal_returns));
+        if (mm_it.first == signal_returns.end() || mm_it.second == signal_returns.end()) return vector<size_t>();
+        return AARC::TA::histogram(signal_returns, (*mm_it.second - *mm_it.first) / 15.0f);
+    }
+} // namespace
 
-    // Minmax
-    const auto &mm_it = minmax_element(begin(signal_returns), end(signal_returns));
-    if (mm_it.first == signal_returns.end() || mm_it.second == signal_returns.end()) return vector<size_t>();
-    return AARC::TA::histogram(signal_returns, (*mm_it.second - *mm_it.first) / 15.0f);
+/* When RSI > upper_threshold, find the return after N periods, bucket into 20 buckets */
+auto AARC::Drift::pr_rsi_short(const TSData &in, const std::vector<float> &rsi,
+                               const std::vector<float> &period_returns, const float upper_threshold)
+    -> std::vector<size_t> {
+    MethodLogger mlog("Drift::pr_rsi_short");
+    return pr_rsi(in, rsi, period_returns, [upper_threshold](const float r) { return r > upper_threshold; }, mlog);
 }
 
-/* When RSI > upper_threshold, find the return after N periods, bucket into 20 buckets */
+/* When RSI < lower_threshold, find the return after N periods, bucket into 20 buckets */
 auto AARC::Drift::pr_rsi_long(const TSData &in, const std::vector<float> &rsi, const std::vector<float> &period_returns,
                               const float lower_threshold) -> std::vector<size_t> {
     MethodLogger mlog("Drift::pr_rsi_long");
-
-    using namespace std;
-    const auto &max_idx       = rsi.size() - (in.ts_.size() - period_returns.size());
-    const auto &rsi_pr_offset = period_returns.size() - rsi.size();
-
-    // Find positions of RSI where they go above upper_threshold
-    const auto &rsi_lower_positions = [&rsi, &max_idx, &rsi_pr_offset, &lower_threshold, &in]() {
-        vector<size_t> res;
-        for (auto &&i = size_t(0); i < max_idx;) {
-            if (rsi[i] < lower_threshold) {
-                res.emplace_back(i + rsi_pr_offset);
-                while (i < max_idx && rsi[i] < lower_threshold) ++i;
-            }
-            ++i;
-        }
-        return res;
-    }();
-
-    const auto &signal_returns = [&rsi_lower_positions, &period_returns, &mlog]() {
-        vector<float> signal_returns;
-        for (auto &&pos : rsi_lower_positions) { signal_returns.emplace_back(period_returns[pos]); }
-        return signal_returns;
-    }();
-
-    // Minmax
-    const auto &mm_it = minmax_element(begin(signal_returns), end(signal_returns));
-    if (mm_it.first == signal_returns.end() || mm_it.second == signal_returns.end()) return vector<size_t>();
-    return AARC::TA::histogram(signal_returns, (*mm_it.second - *mm_it.first) / 15.0f);
+    return pr_rsi(in, rsi, period_returns, [lower_threshold](const float r) { return r < lower_threshold; }, mlog);
 }
 
 auto print_debug(const std::vector<float> &rsi, const AARC::TSData &smooth, const std::vector<float> &pr) {
@@ -115,6 +97,28 @@ void find_optimal(const AARC::TSData &in) {
     }
 }
 
+TEST_CASE("Drift pairs RSI with the return from the same bar") {
+    // RSI from bar 9 over 200 bars, runs above 90 start on bars 40, 60 and 100 and only those bars have a return
+    auto in = AARC::TSData();
+    for (auto i = size_t(0); i < 200; ++i) in.ts_.emplace_back(1000 + i);
+    auto rsi = std::vector<float>(200 - 9, 50.0f);
+    for (const auto bar : {40, 41, 42, 60, 100, 101}) rsi[bar - 9] = 95.0f;
+    auto period_returns = std::vector<float>(195, 0.0f);
+    period_returns[40]  = 1.0f;
+    period_returns[60]  = 2.0f;
+    period_returns[100] = 4.0f;
+
+    const auto short_hist = AARC::Drift::pr_rsi_short(in, rsi, period_returns, 90.0f);
+    REQUIRE(short_hist.size() == 16);
+    CHECK(short_hist[0] == 1);
+    CHECK(short_hist[5] == 1);
+    CHECK(short_hist[15] == 1);
+
+    for (auto &r : rsi) r = 100.0f - r;
+    CHECK(AARC::Drift::pr_rsi_long(in, rsi, period_returns, 10.0f) == short_hist);
+    CHECK(AARC::Drift::pr_rsi_long(in, std::vector<float>(201), period_returns, 10.0f).empty());
+}
+
 TEST_CASE("MLRsi") {
 
     static auto const filename =
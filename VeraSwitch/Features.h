@@ -0,0 +1,70 @@
+#pragma once
+#include "TimeSeries.h"
+#include <vector>
+
+namespace AARC {
+    namespace Features {
+        /* Lines indicators up bar for bar in one column-major matrix, the input to Trees, Bayes and the backtester.
+        A TA function only returns the bars it has a value for, which start once its window has filled, so each
+        indicator's warm-up (its offset) is kept here rather than worked out from vector lengths wherever two are
+        compared. The columns are calculated in parallel and copied into one preallocated buffer */
+
+        // x_[f * rows_ + i] is feature f of row i
+        struct Matrix {
+            size_t             rows_     = 0;
+            size_t             features_ = 0;
+            std::vector<float> x_;
+        };
+
+        // values_[i] is the value at bar offset_ + i
+        struct Column {
+            std::vector<float> values_;
+            size_t             offset_ = 0;
+        };
+
+        // A TA output of bars bars, which like them all ends at the last bar
+        auto trailing(const std::vector<float> &values, const size_t bars) -> Column;
+
+        enum class Indicator {
+            CLOSE,
+            LOG_RETURN,     // From the bar before
+            RSI,            // TA::rsi, period_
+            SMA,            // period_
+            EMA,            // TA::ema, period_
+            MACD,           // Line, signal and histogram of TA::macd, fast period_, slow period2_, signal period3_
+            MACD_SIGNAL,
+            MACD_HISTOGRAM,
+            STOCH_K,        // TA::stoch, %K period_, %D period2_ (3 if 0) and slowing period3_ (1 if 0)
+            STOCH_D,
+            ZSCORE,         // Of the close against its period_ bar window
+            VOLATILITY,     // TA::rolling_volatility over period_, annualised with 252 bars a year
+            FORWARD_RETURN  // Close to close over the next period_ bars, the usual target. Ends period_ bars early
+        };
+
+        struct Spec {
+            Indicator indicator_ = Indicator::CLOSE;
+            size_t    period_    = 14;
+            size_t    period2_   = 0;
+            size_t    period3_   = 0;
+            size_t    lag_       = 0; // The value from lag_ bars before
+        };
+
+        // Bars before the indicator's first value
+        auto offset(const Spec &spec) -> size_t;
+
+        // Empty if there are too few bars
+        auto column(const TSData &bars, const Spec &spec) -> Column;
+
+        // Row i is bar first_bar_ + i, the rows are the bars every column has a value for
+        struct Panel {
+            Matrix              matrix_;
+            size_t              first_bar_ = 0;
+            std::vector<size_t> ts_;
+        };
+
+        auto align(const std::vector<Column> &columns, const std::vector<size_t> &ts) -> Panel;
+
+        // Columns in the order of the specs
+        auto build(const TSData &bars, const std::vector<Spec> &specs) -> Panel;
+    } // namespace Features
+} // namespace AARC
@@ -0,0 +1,192 @@
+#include "ImpliedVol.h"
+#include "BlackScholes.h"
+#include "Split.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <limits>
+#include <map>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+auto AARC::ImpliedVol::add(Quotes &quotes, const double price, const double spot, const double strike,
+                           const double rate, const double dividend, const double expiry, const bool call) -> void {
+    quotes.price_.emplace_back(price);
+    quotes.spot_.emplace_back(spot);
+    quotes.strike_.emplace_back(strike);
+    quotes.rate_.emplace_back(rate);
+    quotes.dividend_.emplace_back(dividend);
+    quotes.expiry_.emplace_back(expiry);
+    quotes.call_.emplace_back(call ? 1 : 0);
+}
+
+auto AARC::ImpliedVol::solve(const Quotes &quotes) -> std::vector<double> {
+    auto vols = std::vector<double>();
+    solve(quotes, vols);
+    return vols;
+}
+
+auto AARC::ImpliedVol::solve(const Quotes &quotes, std::vector<double> &vols) -> void {
+    const auto sz = quotes.price_.size();
+    vols.resize(sz);
+    // Fewer options per task than pricing, each one takes a handful of iterations
+    const auto chunk = size_t(4096);
+    concurrency::parallel_for(size_t(0), (sz + chunk - 1) / chunk, [&](const size_t c) {
+        const auto i = c * chunk;
+        ispc::implied_vol(quotes.price_.data() + i, quotes.spot_.data() + i, quotes.strike_.data() + i,
+                          quotes.rate_.data() + i, quotes.dividend_.data() + i, quotes.expiry_.data() + i,
+                          quotes.call_.data() + i, vols.data() + i, std::min(chunk, sz - i));
+    });
+}
+
+auto AARC::ImpliedVol::surface(const Quotes &quotes, const std::vector<double> &vols, const size_t strike_points)
+    -> Surface {
+    using namespace std;
+    MethodLogger mlog("ImpliedVol::surface");
+    auto         out = Surface();
+    if (vols.size() != quotes.price_.size()) {
+        mlog.logger()->error("{} vols for {} quotes", vols.size(), quotes.price_.size());
+        return out;
+    }
+    // Strike -> (sum, count) per expiry, averaging calls and puts quoted at the same strike
+    auto smiles = map<double, map<double, pair<double, size_t>>>();
+    auto lo = numeric_limits<double>::max(), hi = numeric_limits<double>::lowest();
+    for (auto i = size_t(0); i < vols.size(); ++i) {
+        // Every expiry gets a row, even with nothing to fill it
+        auto &smile = smiles[quotes.expiry_[i]];
+        if (!isfinite(vols[i])) continue;
+        auto &p = smile[quotes.strike_[i]];
+        p.first += vols[i];
+        ++p.second;
+        lo = min(lo, quotes.strike_[i]);
+        hi = max(hi, quotes.strike_[i]);
+    }
+    if (lo > hi || strike_points == 0) return out;
+    out.strikes_.resize(strike_points);
+    for (auto k = size_t(0); k < strike_points; ++k) {
+        out.strikes_[k] = strike_points == 1 ? lo : lo + (hi - lo) * k / (strike_points - 1);
+    }
+    out.vols_.reserve(smiles.size() * strike_points);
+    for (const auto &smile : smiles) {
+        out.expiries_.emplace_back(smile.first);
+        if (smile.second.empty()) {
+            out.vols_.insert(end(out.vols_), strike_points, numeric_limits<double>::quiet_NaN());
+            continue;
+        }
+        auto strikes = vector<double>(), vs = vector<double>();
+        for (const auto &p : smile.second) {
+            strikes.emplace_back(p.first);
+            vs.emplace_back(p.second.first / p.second.second);
+        }
+        for (const auto k : out.strikes_) {
+            const auto j = size_t(upper_bound(begin(strikes), end(strikes), k) - begin(strikes));
+            if (j == 0) out.vols_.emplace_back(vs.front());
+            else if (j == strikes.size()) out.vols_.emplace_back(vs.back());
+            else {
+                const auto w = (k - strikes[j - 1]) / (strikes[j] - strikes[j - 1]);
+                out.vols_.emplace_back(vs[j - 1] + w * (vs[j] - vs[j - 1]));
+            }
+        }
+    }
+    return out;
+}
+
+TEST_CASE("Implied vol round trip") {
+    using namespace AARC::ImpliedVol;
+    auto quotes = Quotes();
+    auto truth  = std::vector<double>();
+    for (auto i = 0; i < 20000; ++i) {
+        const auto k = 30.0 + 0.02 * (i % 10000), v = 0.05 + 0.01 * (i % 97), t = 0.02 + 0.01 * (i % 300);
+        const auto r = 0.03, q = 0.01 * (i % 3);
+        const bool call = i % 2 == 0;
+        const auto p = AARC::BlackScholes::value(100.0, k, v, r, q, t, call);
+        // Prices too small to carry the vol in double precision aren't a fair test
+        if (AARC::BlackScholes::vega(100.0, k, v, r, q, t) < 1e-6) continue;
+        add(quotes, p, 100.0, k, r, q, t, call);
+        truth.emplace_back(v);
+    }
+    const auto vols = solve(quotes);
+    REQUIRE(vols.size() == truth.size());
+    /* Out of the money the vol comes back to close to double precision. Deep in the money the time value is near
+    the price's rounding, so there the error is measured in price, vol error times vega against the price */
+    auto vol_error = 0.0, price_error = 0.0;
+    for (auto i = size_t(0); i < vols.size(); ++i) {
+        const auto k = quotes.strike_[i], t = quotes.expiry_[i], q = quotes.dividend_[i], r = quotes.rate_[i];
+        const auto otm = (k > 100.0 * std::exp((r - q) * t)) == (quotes.call_[i] != 0);
+        if (otm) vol_error = std::max(vol_error, std::abs(vols[i] - truth[i]) / truth[i]);
+        price_error = std::max(price_error, std::abs(vols[i] - truth[i]) *
+                                                AARC::BlackScholes::vega(100.0, k, truth[i], r, q, t) /
+                                                quotes.price_[i]);
+    }
+    CHECK(vol_error < 1e-13);
+    CHECK(price_error < 1e-11);
+
+    // Below intrinsic, above the forward and expired all have no vol
+    auto bad = Quotes();
+    add(bad, 9.0, 100.0, 90.0, 0.0, 0.0, 1.0, true);
+    add(bad, 101.0, 100.0, 90.0, 0.0, 0.0, 1.0, true);
+    add(bad, 10.0, 100.0, 90.0, 0.0, 0.0, 0.0, true);
+    add(bad, 1.0, 100.0, 90.0, 0.0, 0.0, 1.0, false);
+    const auto none = solve(bad);
+    CHECK(std::isnan(none[0]));
+    CHECK(std::isnan(none[1]));
+    CHECK(std::isnan(none[2]));
+    CHECK(none[3] > 0.0);
+}
+
+TEST_CASE("Implied vol surface") {
+    using namespace AARC::ImpliedVol;
+    auto quotes = Quotes();
+    // Smile in strike that steepens with expiry, calls and puts on every strike
+    const auto smile = [](const double k, const double t) { return 0.2 + 0.001 * t * std::abs(k - 100.0); };
+    for (const auto t : {0.25, 0.5, 1.0}) {
+        for (auto k = 80.0; k <= 120.0; k += 5.0) {
+            for (const auto call : {true, false}) {
+                add(quotes, AARC::BlackScholes::value(100.0, k, smile(k, t), 0.02, 0.0, t, call), 100.0, k, 0.02, 0.0,
+                    t, call);
+            }
+        }
+    }
+    const auto s = surface(quotes, solve(quotes), 17);
+    REQUIRE(s.expiries_ == std::vector<double>({0.25, 0.5, 1.0}));
+    REQUIRE(s.strikes_.size() == 17);
+    REQUIRE(s.vols_.size() == 3 * 17);
+    CHECK(s.strikes_.front() == 80.0);
+    CHECK(s.strikes_.back() == 120.0);
+    for (auto e = size_t(0); e < 3; ++e) {
+        for (auto k = size_t(0); k < 17; k += 2) {
+            CHECK(s.vols_[e * 17 + k] == doctest::Approx(smile(s.strikes_[k], s.expiries_[e])).epsilon(1e-8));
+        }
+    }
+    // Between quoted strikes the vol is interpolated
+    CHECK(s.vols_[17 + 1] == doctest::Approx(0.5 * (smile(80.0, 0.5) + smile(85.0, 0.5))));
+    CHECK(surface(quotes, std::vector<double>(3), 10).vols_.empty());
+
+    // An expiry whose only quote is below intrinsic keeps its row, all NaN
+    auto stale = quotes;
+    add(stale, 0.0, 100.0, 90.0, 0.02, 0.0, 2.0, true);
+    const auto gap = surface(stale, solve(stale), 17);
+    REQUIRE(gap.expiries_ == std::vector<double>({0.25, 0.5, 1.0, 2.0}));
+    REQUIRE(gap.vols_.size() == 4 * 17);
+    CHECK(std::all_of(begin(gap.vols_) + 3 * 17, end(gap.vols_), [](const double v) { return std::isnan(v); }));
+    CHECK(std::equal(begin(s.vols_), end(s.vols_), begin(gap.vols_)));
+}
+
+TEST_CASE("Implied vol benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::ImpliedVol;
+    using namespace std::chrono;
+    auto quotes = Quotes();
+    for (auto i = 0; i < 1000000; ++i) {
+        const auto k = 50.0 + i % 100, v = 0.1 + 0.01 * (i % 40), t = 0.05 + 0.01 * (i % 200);
+        add(quotes, AARC::BlackScholes::value(100.0, k, v, 0.03, 0.0, t, i % 2 == 0), 100.0, k, 0.03, 0.0, t,
+            i % 2 == 0);
+    }
+    auto       vols  = std::vector<double>();
+    const auto start = high_resolution_clock::now();
+    solve(quotes, vols);
+    const auto us = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    CHECK(vols.size() == quotes.price_.size());
+    spdlog::get("logger")->info("Implied vol 1m options {}us", us);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace AARC {
+    namespace ImpliedVol {
+        /* Market quotes for a chain in SoA layout, in double since the vol is only as good as the price it comes
+         * from. call_ is 1 for a call and 0 for a put, expiry_ in years */
+        struct Quotes {
+            std::vector<double> price_;
+            std::vector<double> spot_;
+            std::vector<double> strike_;
+            std::vector<double> rate_;
+            std::vector<double> dividend_;
+            std::vector<double> expiry_;
+            std::vector<int8_t> call_;
+        };
+
+        /* Vol surface ready for display, vols_[e * strikes_.size() + k] is the vol at expiries_[e] and strikes_[k].
+         * NaN where an expiry has no usable quotes */
+        struct Surface {
+            std::vector<double> expiries_;
+            std::vector<double> strikes_;
+            std::vector<double> vols_;
+        };
+
+        auto add(Quotes &quotes, const double price, const double spot, const double strike, const double rate,
+                 const double dividend, const double expiry, const bool call) -> void;
+
+        /* Implied vol of every quote, solved in parallel to close to double precision. NaN where the price is at or
+         * outside the no arbitrage bounds (at most intrinsic, at least the forward) or the option has expired */
+        auto solve(const Quotes &quotes) -> std::vector<double>;
+        // Reuses vols' buffer
+        auto solve(const Quotes &quotes, std::vector<double> &vols) -> void;
+
+        /* Grid of one row per distinct expiry and strike_points evenly spaced strikes across the quoted range. Within
+        an expiry vols are linear in strike and flat past the outermost quotes, a call and a put at the same strike
+        are averaged. vols are the solve() results for quotes */
+        auto surface(const Quotes &quotes, const std::vector<double> &vols, const size_t strike_points) -> Surface;
+    } // namespace ImpliedVol
+} // namespace AARC
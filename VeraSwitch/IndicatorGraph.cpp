@@ -0,0 +1,462 @@
+#include "IndicatorGraph.h"
+#include "TimeSeries.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <numeric>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+namespace {
+    using namespace AARC::IndicatorGraph;
+
+    auto add_node(Graph &g, const Op op, const size_t period, const NodeId a, const NodeId b = npos) -> NodeId {
+        const auto key = std::make_tuple(op, period, a, b);
+        const auto it  = g.index_.find(key);
+        if (it != g.index_.end()) return it->second;
+        // Inputs always exist before the node that uses them so node ids are already in topological order
+        const auto id = g.nodes_.size();
+        g.nodes_.emplace_back(Node{op, period, {{a, b}}});
+        g.index_.emplace(key, id);
+        return id;
+    }
+
+    auto end_of(const Series &s) { return s.offset_ + s.values_.size(); }
+
+    auto column(const AARC::TSData &in, const Op op) -> const std::vector<float> & {
+        switch (op) {
+        case Op::OPEN: return in.open_;
+        case Op::HIGH: return in.high_;
+        case Op::LOW: return in.low_;
+        default: return in.close_;
+        }
+    }
+
+    // Applies f to each bar of the overlap of the inputs and [lo, hi)
+    template <typename F> auto elementwise(const Series &a, const size_t lo, const size_t hi, F &&f) -> Series {
+        const auto first = std::max(lo, a.offset_), last = std::min(hi, end_of(a));
+        auto       out   = Series{first, std::vector<float>(last > first ? last - first : 0)};
+        for (auto t = first; t < last; ++t) out.values_[t - first] = f(a.values_[t - a.offset_]);
+        return out;
+    }
+
+    template <typename F>
+    auto elementwise(const Series &a, const Series &b, const size_t lo, const size_t hi, F &&f) -> Series {
+        const auto first = std::max({lo, a.offset_, b.offset_}), last = std::min({hi, end_of(a), end_of(b)});
+        auto       out   = Series{first, std::vector<float>(last > first ? last - first : 0)};
+        for (auto t = first; t < last; ++t)
+            out.values_[t - first] = f(a.values_[t - a.offset_], b.values_[t - b.offset_]);
+        return out;
+    }
+
+    auto delta(const Series &a, const size_t lo, const size_t hi) -> Series {
+        const auto first = std::max(lo, a.offset_ + 1), last = std::min(hi, end_of(a));
+        auto       out   = Series{first, std::vector<float>(last > first ? last - first : 0)};
+        for (auto t = first; t < last; ++t)
+            out.values_[t - first] = a.values_[t - a.offset_] - a.values_[t - 1 - a.offset_];
+        return out;
+    }
+
+    // Running sum kept in double, a float accumulator drifts badly over a few years of minute bars
+    auto sma(const Series &a, const size_t period, const size_t lo, const size_t hi) -> Series {
+        const auto first = std::max(lo, a.offset_ + period - 1), last = std::min(hi, end_of(a));
+        if (period == 0 || last <= first) return Series{first, {}};
+        auto out = Series{first, std::vector<float>(last - first)};
+        auto sum = 0.0;
+        for (auto t = first + 1 - period; t <= first; ++t) sum += a.values_[t - a.offset_];
+        out.values_[0] = static_cast<float>(sum / period);
+        for (auto t = first + 1; t < last; ++t) {
+            sum += a.values_[t - a.offset_] - a.values_[t - period - a.offset_];
+            out.values_[t - first] = static_cast<float>(sum / period);
+        }
+        return out;
+    }
+
+    struct Warm {
+        size_t                   resume      = npos; // Checkpoint bar the state is for, npos seeds from the input
+        float                    state       = 0.0f;
+        size_t                   exact_from  = 0;
+        size_t                   stride      = 0;
+        std::map<size_t, float> *checkpoints = nullptr;
+        size_t                   warm_up     = 0; // Bars for a fresh seed to be forgotten
+    };
+
+    /* Recursive average seeded with the simple average of the first period values of the input, or restarted from a
+     * checkpoint. States past exact_from are saved into the checkpoints as we go */
+    auto exp_average(const Series &a, const size_t period, const float alpha, const size_t lo, const size_t hi,
+                     const Warm &warm) -> Series {
+        const auto last    = std::min(hi, end_of(a));
+        const auto resumed = warm.resume != npos && a.offset_ <= warm.resume + 1;
+        const auto from    = resumed ? warm.resume : a.offset_ + period - 1;
+        const auto first   = std::max(lo, from);
+        if (period == 0 || last <= first) return Series{first, {}};
+        auto out  = Series{first, std::vector<float>(last - first)};
+        auto prev = warm.state;
+        if (!resumed) {
+            prev = 0.0f;
+            for (auto t = a.offset_; t <= from; ++t) prev += a.values_[t - a.offset_];
+            prev /= static_cast<float>(period);
+        }
+        if (from >= first) out.values_[from - first] = prev;
+        // A checkpoint that the input starts after is seeded past again, the states only settle after the warm up
+        const auto exact_from = warm.resume != npos && !resumed ? from + warm.warm_up : warm.exact_from;
+        const auto record     = warm.checkpoints != nullptr && warm.stride > 0;
+        for (auto t = from + 1; t < last; ++t) {
+            prev += alpha * (a.values_[t - a.offset_] - prev);
+            if (t >= first) out.values_[t - first] = prev;
+            if (record && t % warm.stride == 0 && t >= exact_from) (*warm.checkpoints)[t] = prev;
+        }
+        return out;
+    }
+
+    auto period_return(const Series &a, const size_t look_ahead, const size_t lo, const size_t hi) -> Series {
+        const auto first = std::max(lo, a.offset_), end = end_of(a);
+        const auto last  = std::min(hi, end > look_ahead ? end - look_ahead : 0);
+        auto       out   = Series{first, std::vector<float>(last > first ? last - first : 0)};
+        for (auto t = first; t < last; ++t)
+            out.values_[t - first] = a.values_[t + look_ahead - a.offset_] / a.values_[t - a.offset_] - 1.0f;
+        return out;
+    }
+
+    auto calculate(const Node &node, const std::vector<Series> &results, const AARC::TSData &in, const size_t lo,
+                   const size_t hi, const Warm &warm) -> Series {
+        static const auto empty = Series();
+        const auto &      a     = node.inputs_[0] == npos ? empty : results[node.inputs_[0]];
+        const auto &      b     = node.inputs_[1] == npos ? empty : results[node.inputs_[1]];
+        switch (node.op_) {
+        case Op::OPEN:
+        case Op::HIGH:
+        case Op::LOW:
+        case Op::CLOSE: {
+            const auto &col = column(in, node.op_);
+            const auto  end = std::min(hi, col.size());
+            return Series{lo, end > lo ? std::vector<float>(col.begin() + lo, col.begin() + end)
+                                       : std::vector<float>()};
+        }
+        case Op::DELTA: return delta(a, lo, hi);
+        case Op::GAIN: return elementwise(a, lo, hi, [](const float d) { return d > 0.0f ? d : 0.0f; });
+        case Op::LOSS: return elementwise(a, lo, hi, [](const float d) { return d < 0.0f ? -d : 0.0f; });
+        case Op::SMA: return sma(a, node.period_, lo, hi);
+        case Op::EMA: return exp_average(a, node.period_, 2.0f / (node.period_ + 1.0f), lo, hi, warm);
+        case Op::WILDER: return exp_average(a, node.period_, 1.0f / node.period_, lo, hi, warm);
+        case Op::SUB: return elementwise(a, b, lo, hi, [](const float x, const float y) { return x - y; });
+        case Op::RSI:
+            return elementwise(a, b, lo, hi, [](const float up, const float down) {
+                return down == 0.0f ? 100.0f : 100.0f - 100.0f / (1.0f + up / down);
+            });
+        case Op::PERIOD_RETURN: return period_return(a, node.period_, lo, hi);
+        }
+        return Series{lo, {}};
+    }
+
+    auto is_recursive(const Node &node) { return node.op_ == Op::EMA || node.op_ == Op::WILDER; }
+
+    // Bars of input needed before the first and after the last bar of output
+    auto input_range(const Node &node, const size_t lo, const size_t hi) -> std::pair<size_t, size_t> {
+        switch (node.op_) {
+        case Op::DELTA: return {lo > 0 ? lo - 1 : 0, hi};
+        case Op::SMA: return {lo > node.period_ ? lo - node.period_ + 1 : 0, hi};
+        case Op::EMA:
+        case Op::WILDER: {
+            const auto warm = warm_up(node) + node.period_;
+            return {lo > warm ? lo - warm : 0, hi};
+        }
+        case Op::PERIOD_RETURN: return {lo, hi + node.period_};
+        default: return {lo, hi};
+        }
+    }
+} // namespace
+
+auto AARC::IndicatorGraph::source(Graph &g, const Op column) -> NodeId { return add_node(g, column, 0, npos); }
+auto AARC::IndicatorGraph::delta(Graph &g, const NodeId in) -> NodeId { return add_node(g, Op::DELTA, 0, in); }
+auto AARC::IndicatorGraph::gain(Graph &g, const NodeId delta) -> NodeId { return add_node(g, Op::GAIN, 0, delta); }
+auto AARC::IndicatorGraph::loss(Graph &g, const NodeId delta) -> NodeId { return add_node(g, Op::LOSS, 0, delta); }
+
+auto AARC::IndicatorGraph::sma(Graph &g, const NodeId in, const size_t period) -> NodeId {
+    return add_node(g, Op::SMA, period, in);
+}
+
+auto AARC::IndicatorGraph::ema(Graph &g, const NodeId in, const size_t period) -> NodeId {
+    return add_node(g, Op::EMA, period, in);
+}
+
+auto AARC::IndicatorGraph::wilder(Graph &g, const NodeId in, const size_t period) -> NodeId {
+    return add_node(g, Op::WILDER, period, in);
+}
+
+auto AARC::IndicatorGraph::sub(Graph &g, const NodeId a, const NodeId b) -> NodeId {
+    return add_node(g, Op::SUB, 0, a, b);
+}
+
+auto AARC::IndicatorGraph::period_return(Graph &g, const NodeId in, const size_t look_ahead_period) -> NodeId {
+    return add_node(g, Op::PERIOD_RETURN, look_ahead_period, in);
+}
+
+/* Wilder's RSI, the gains and losses share one delta node with anything else looking at the same input */
+auto AARC::IndicatorGraph::rsi(Graph &g, const NodeId in, const size_t period) -> NodeId {
+    const auto d = delta(g, in);
+    return add_node(g, Op::RSI, period, wilder(g, gain(g, d), period), wilder(g, loss(g, d), period));
+}
+
+auto AARC::IndicatorGraph::macd(Graph &g, const NodeId in, const size_t fast_period, const size_t slow_period,
+                                const size_t signal_period) -> MACDNodes {
+    const auto line   = sub(g, ema(g, in, fast_period), ema(g, in, slow_period));
+    const auto signal = ema(g, line, signal_period);
+    return MACDNodes{line, signal, sub(g, line, signal)};
+}
+
+auto AARC::IndicatorGraph::warm_up(const Node &node) -> size_t {
+    if (!is_recursive(node) || node.period_ <= 1) return 0;
+    const auto alpha = node.op_ == Op::EMA ? 2.0 / (node.period_ + 1.0) : 1.0 / node.period_;
+    // (1 - alpha)^n < float epsilon
+    return static_cast<size_t>(std::ceil(std::log(1e-7) / std::log(1.0 - alpha)));
+}
+
+auto AARC::IndicatorGraph::plan(const Graph &g, const std::vector<NodeId> &outputs, const size_t bars,
+                                const size_t start, const size_t fin, const WarmCache *cache) -> Plan {
+    using namespace std;
+    const auto sz  = g.nodes_.size();
+    const auto hi  = min(fin, bars);
+    auto       res = Plan{vector<bool>(sz, false), vector<pair<size_t, size_t>>(sz, {bars, 0}), {},
+                    vector<size_t>(sz, npos), vector<size_t>(sz, 0)};
+    for (const auto out : outputs) {
+        if (out >= sz) continue;
+        res.required_[out] = true;
+        res.range_[out]    = {min(res.range_[out].first, start), max(res.range_[out].second, hi)};
+    }
+    // Walk back from the outputs widening each input's range by what its consumers need
+    for (auto n = sz; n-- > 0;) {
+        if (!res.required_[n]) continue;
+        const auto &node = g.nodes_[n];
+        const auto  lo   = res.range_[n].first;
+        auto        need = input_range(node, lo, res.range_[n].second);
+        if (is_recursive(node)) {
+            // A checkpoint closer than the warm up means only the bars after it are needed
+            const auto warm = warm_up(node) + node.period_;
+            if (cache != nullptr && n < cache->states_.size() && !cache->states_[n].empty()) {
+                const auto &states = cache->states_[n];
+                auto        it     = states.upper_bound(lo);
+                if (it != states.begin() && lo - (--it)->first <= warm) {
+                    res.resume_[n] = it->first;
+                    need.first     = it->first + 1;
+                }
+            }
+            res.exact_from_[n] = res.resume_[n] != npos || need.first == 0 ? 0 : need.first + warm;
+        }
+        for (const auto in : node.inputs_) {
+            if (in == npos) continue;
+            res.required_[in] = true;
+            res.range_[in]    = {min(res.range_[in].first, need.first),
+                              min(bars, max(res.range_[in].second, need.second))};
+        }
+    }
+    // Level is the longest path from a source, nodes on the same level can be run together
+    auto level = vector<size_t>(sz, 0);
+    for (auto n = size_t(0); n < sz; ++n) {
+        if (!res.required_[n]) continue;
+        for (const auto in : g.nodes_[n].inputs_) {
+            if (in != npos) level[n] = max(level[n], level[in] + 1);
+        }
+        if (res.levels_.size() <= level[n]) res.levels_.resize(level[n] + 1);
+        res.levels_[level[n]].emplace_back(n);
+    }
+    return res;
+}
+
+namespace {
+    auto run(const Graph &g, const AARC::TSData &in, const std::vector<NodeId> &outputs, const size_t start,
+             const size_t fin, WarmCache *cache) -> std::vector<Series> {
+        using namespace std;
+        const auto p = plan(g, outputs, in.ts_.size(), start, fin, cache);
+        if (cache != nullptr && cache->states_.size() < g.nodes_.size()) cache->states_.resize(g.nodes_.size());
+        auto results = vector<Series>(g.nodes_.size());
+        for (const auto &level : p.levels_) {
+            // Each node writes only its own slot and checkpoints and reads from earlier levels, so no locking needed
+            concurrency::parallel_for(size_t(0), level.size(), [&](const size_t i) {
+                const auto n    = level[i];
+                auto       warm = Warm();
+                if (is_recursive(g.nodes_[n])) {
+                    warm.resume     = p.resume_[n];
+                    warm.state      = warm.resume != npos ? cache->states_[n].at(warm.resume) : 0.0f;
+                    warm.exact_from = p.exact_from_[n];
+                    warm.warm_up    = AARC::IndicatorGraph::warm_up(g.nodes_[n]);
+                    if (cache != nullptr) {
+                        warm.stride      = cache->stride_;
+                        warm.checkpoints = &cache->states_[n];
+                    }
+                }
+                results[n] = calculate(g.nodes_[n], results, in, p.range_[n].first, p.range_[n].second, warm);
+            });
+        }
+        // Nodes that are both outputs and inputs to others may have been calculated over a wider range
+        auto out = vector<Series>();
+        out.reserve(outputs.size());
+        for (const auto n : outputs) {
+            if (n >= results.size()) {
+                out.emplace_back();
+                continue;
+            }
+            const auto &s     = results[n];
+            const auto  first = max(start, s.offset_), last = min(fin, end_of(s));
+            out.emplace_back(Series{first, last > first ? vector<float>(s.values_.begin() + (first - s.offset_),
+                                                                        s.values_.begin() + (last - s.offset_))
+                                                        : vector<float>()});
+        }
+        return out;
+    }
+} // namespace
+
+auto AARC::IndicatorGraph::evaluate(const Graph &g, const TSData &in, const std::vector<NodeId> &outputs,
+                                    const size_t start, const size_t fin) -> std::vector<Series> {
+    MethodLogger mlog("IndicatorGraph::evaluate");
+    return run(g, in, outputs, start, fin, nullptr);
+}
+
+auto AARC::IndicatorGraph::evaluate(const Graph &g, const TSData &in, const std::vector<NodeId> &outputs,
+                                    const size_t start, const size_t fin, WarmCache &cache) -> std::vector<Series> {
+    MethodLogger mlog("IndicatorGraph::evaluate");
+    return run(g, in, outputs, start, fin, &cache);
+}
+
+auto AARC::IndicatorGraph::visible_range(const TSData &in, const size_t ts_start, const size_t ts_end)
+    -> std::pair<size_t, size_t> {
+    using namespace std;
+    const auto lb = lower_bound(begin(in.ts_), end(in.ts_), ts_start);
+    const auto ub = upper_bound(lb, end(in.ts_), ts_end);
+    return {static_cast<size_t>(distance(begin(in.ts_), lb)), static_cast<size_t>(distance(begin(in.ts_), ub))};
+}
+
+namespace {
+    auto synthetic_bars(const size_t sz) {
+        auto data = AARC::TSData();
+        data.reserve(sz);
+        for (auto i = size_t(0); i < sz; ++i) {
+            const auto close = 100.0f + 10.0f * std::sin(i / 50.0f) + 3.0f * std::sin(i / 7.0f) + i * 0.001f;
+            data.ts_.emplace_back(i);
+            data.open_.emplace_back(close - 0.5f);
+            data.high_.emplace_back(close + 1.0f);
+            data.low_.emplace_back(close - 1.0f);
+            data.close_.emplace_back(close);
+        }
+        return data;
+    }
+
+    auto reference_ema(const std::vector<float> &in, const size_t period) {
+        const auto alpha = 2.0f / (period + 1.0f);
+        auto       out   = std::vector<float>(in.size(), 0.0f);
+        auto       prev  = 0.0f;
+        for (auto i = size_t(0); i < period; ++i) prev += in[i];
+        prev /= period;
+        out[period - 1] = prev;
+        for (auto i = period; i < in.size(); ++i) out[i] = prev += alpha * (in[i] - prev);
+        return out;
+    }
+} // namespace
+
+TEST_SUITE("IndicatorGraph") {
+    TEST_CASE("Shared sub-expressions") {
+        namespace IG  = AARC::IndicatorGraph;
+        auto       g  = IG::Graph();
+        const auto c  = IG::source(g, IG::Op::CLOSE);
+        const auto m1 = IG::macd(g, c, 12, 26, 9);
+        const auto sz = g.nodes_.size();
+        // Same MACD again adds nothing, a second MACD with the same fast period shares EMA(12)
+        const auto m2 = IG::macd(g, c, 12, 26, 9);
+        CHECK(m1.line_ == m2.line_);
+        CHECK(g.nodes_.size() == sz);
+        IG::macd(g, c, 12, 50, 9);
+        CHECK(g.nodes_.size() == sz + 4);
+        // RSI and a Drift style delta share the close delta
+        const auto d = IG::delta(g, c);
+        IG::rsi(g, c, 14);
+        CHECK(IG::delta(g, c) == d);
+    }
+
+    TEST_CASE("Lazy evaluation") {
+        namespace IG    = AARC::IndicatorGraph;
+        const auto data = synthetic_bars(5000);
+        auto       g    = IG::Graph();
+        const auto c    = IG::source(g, IG::Op::CLOSE);
+        const auto m    = IG::macd(g, c, 12, 26, 9);
+        const auto r    = IG::rsi(g, c, 14);
+        const auto s    = IG::sma(g, c, 20);
+
+        // Only the RSI chain is needed for the RSI
+        const auto p = IG::plan(g, {r}, data.ts_.size());
+        CHECK(!p.required_[m.line_]);
+        CHECK(!p.required_[s]);
+        CHECK(p.required_[c]);
+
+        const auto res = IG::evaluate(g, data, {m.line_, m.signal_, m.histogram_, r, s});
+        REQUIRE(res.size() == 5);
+        const auto fast = reference_ema(data.close_, 12), slow = reference_ema(data.close_, 26);
+        CHECK(res[0].offset_ == 25);
+        for (auto i = size_t(0); i < res[0].values_.size(); ++i) {
+            const auto t = res[0].offset_ + i;
+            CHECK(res[0].values_[i] == doctest::Approx(fast[t] - slow[t]).epsilon(0.0001));
+        }
+        CHECK(res[1].offset_ == 25 + 8);
+        CHECK(res[2].values_.back() == doctest::Approx(res[0].values_.back() - res[1].values_.back()));
+        for (const auto v : res[3].values_) {
+            CHECK(v >= 0.0f);
+            CHECK(v <= 100.0f);
+        }
+        const auto first_sma = std::accumulate(data.close_.begin(), data.close_.begin() + 20, 0.0) / 20.0;
+        CHECK(res[4].values_[0] == doctest::Approx(first_sma));
+
+        // A window only warms up from just before the visible bars but ends up at the same values
+        const auto win = IG::evaluate(g, data, {r, s, m.signal_}, 3000, 3100);
+        REQUIRE(win[0].values_.size() == 100);
+        REQUIRE(win[1].values_.size() == 100);
+        REQUIRE(win[2].values_.size() == 100);
+        CHECK(win[0].values_[0] == doctest::Approx(res[3].values_[3000 - res[3].offset_]));
+        CHECK(win[1].values_[99] == doctest::Approx(res[4].values_[3099 - res[4].offset_]));
+        CHECK(win[2].values_[50] == doctest::Approx(res[1].values_[3050 - res[1].offset_]));
+    }
+
+    TEST_CASE("Visible range with warm state checkpoints") {
+        namespace IG    = AARC::IndicatorGraph;
+        const auto data = synthetic_bars(20000);
+        auto       g    = IG::Graph();
+        const auto c    = IG::source(g, IG::Op::CLOSE);
+        const auto e    = IG::ema(g, c, 200);
+        const auto r    = IG::rsi(g, c, 14);
+        const auto full = IG::evaluate(g, data, {e, r});
+
+        // Without checkpoints only the warm up before the window is read
+        const auto range = IG::visible_range(data, 15000, 15099);
+        CHECK(range.first == 15000);
+        CHECK(range.second == 15100);
+        const auto cold = IG::plan(g, {e}, data.ts_.size(), range.first, range.second);
+        CHECK(cold.range_[c].first == range.first - IG::warm_up(g.nodes_[e]) - 200);
+        CHECK(cold.resume_[e] == IG::npos);
+
+        // Scrolling over the chart once leaves checkpoints behind, coming back restarts from the nearest one
+        auto cache = IG::WarmCache();
+        for (auto bar = size_t(0); bar < data.ts_.size(); bar += 1000)
+            IG::evaluate(g, data, {e, r}, bar, bar + 1000, cache);
+        const auto warm = IG::plan(g, {e}, data.ts_.size(), range.first, range.second, &cache);
+        REQUIRE(warm.resume_[e] != IG::npos);
+        CHECK(range.first - warm.resume_[e] < cache.stride_);
+        CHECK(warm.range_[c].first == warm.resume_[e] + 1);
+
+        const auto win = IG::evaluate(g, data, {e, r}, range.first, range.second, cache);
+        REQUIRE(win[0].values_.size() == 100);
+        for (auto i = size_t(0); i < 100; ++i) {
+            CHECK(win[0].values_[i] == doctest::Approx(full[0].values_[range.first + i - full[0].offset_]));
+            CHECK(win[1].values_[i] == doctest::Approx(full[1].values_[range.first + i - full[1].offset_]));
+        }
+    }
+
+    TEST_CASE("Seeding again past a checkpoint only saves settled states") {
+        // The input starts at bar 50, after the checkpoint at 10, so the average is seeded afresh at bar 59
+        auto       checkpoints = std::map<size_t, float>{{10, 1.0f}};
+        const auto warm        = Warm{10, 1.0f, 0, 5, &checkpoints, 30};
+        const auto a           = Series{50, std::vector<float>(1000, 2.0f)};
+        const auto out         = exp_average(a, 10, 2.0f / 11.0f, 0, 1050, warm);
+        CHECK(out.offset_ == 59);
+        REQUIRE(checkpoints.size() > 1);
+        CHECK(std::next(checkpoints.begin())->first == 90);
+    }
+}
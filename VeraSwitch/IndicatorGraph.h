@@ -0,0 +1,98 @@
+#pragma once
+#include <array>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace AARC {
+    struct TSData;
+    namespace IndicatorGraph {
+        /* Indicators are described as a small expression graph over the TSData columns rather than calculated
+        directly. Two indicators asking for the same sub-expression (EMA(close, 12) for a pair of MACDs, the close
+        deltas for RSI and Drift) get the same node back so it is only calculated once. Nothing is calculated until
+        evaluate is called, and then only the nodes the requested outputs depend on, for the bars they need.
+        */
+        using NodeId              = size_t;
+        constexpr NodeId npos     = std::numeric_limits<NodeId>::max();
+        constexpr size_t all_bars = std::numeric_limits<size_t>::max();
+
+        enum class Op { OPEN, HIGH, LOW, CLOSE, DELTA, GAIN, LOSS, SMA, EMA, WILDER, SUB, RSI, PERIOD_RETURN };
+
+        struct Node {
+            Op                    op_;
+            size_t                period_ = 0;
+            std::array<NodeId, 2> inputs_ = {{npos, npos}};
+        };
+
+        struct Graph {
+            std::vector<Node>                                        nodes_;
+            std::map<std::tuple<Op, size_t, NodeId, NodeId>, NodeId> index_;
+        };
+
+        /* Output of a node, aligned to the input bars. values_[i] is the value at bar offset_ + i, bars before
+         * offset_ are still warming up */
+        struct Series {
+            size_t             offset_ = 0;
+            std::vector<float> values_;
+        };
+
+        // Builders, each returns the existing node if the same expression has been added before
+        auto source(Graph &g, const Op column) -> NodeId;
+        auto delta(Graph &g, const NodeId in) -> NodeId;
+        auto gain(Graph &g, const NodeId delta) -> NodeId;
+        auto loss(Graph &g, const NodeId delta) -> NodeId;
+        auto sma(Graph &g, const NodeId in, const size_t period) -> NodeId;
+        auto ema(Graph &g, const NodeId in, const size_t period) -> NodeId;
+        auto wilder(Graph &g, const NodeId in, const size_t period) -> NodeId;
+        auto sub(Graph &g, const NodeId a, const NodeId b) -> NodeId;
+        auto period_return(Graph &g, const NodeId in, const size_t look_ahead_period) -> NodeId;
+
+        // Composite indicators built from the nodes above
+        auto rsi(Graph &g, const NodeId in, const size_t period) -> NodeId;
+        struct MACDNodes {
+            NodeId line_, signal_, histogram_;
+        };
+        auto macd(Graph &g, const NodeId in, const size_t fast_period, const size_t slow_period,
+                  const size_t signal_period) -> MACDNodes;
+
+        /* State of the recursive averages (EMA, Wilder) saved every stride_ bars as they are calculated. Scrolling
+        back to a chart area that has been seen before then restarts from the nearest checkpoint instead of warming
+        up again. The states are only valid for the graph and data they were calculated with, appending bars is fine
+        but anything that rewrites history needs a clear() */
+        struct WarmCache {
+            size_t                               stride_ = 256;
+            std::vector<std::map<size_t, float>> states_;
+            void                                 clear() { states_.clear(); }
+        };
+
+        /* Which nodes have to be calculated for the outputs, and the [first, last) bar range each one needs so that
+         * the outputs are correct over [start, fin) */
+        struct Plan {
+            std::vector<bool>                      required_;
+            std::vector<std::pair<size_t, size_t>> range_;
+            std::vector<std::vector<NodeId>>       levels_;
+            // Recursive nodes only, checkpoint bar to restart from (npos to seed from the input) and the first bar
+            // after which their state is warm enough to save as a checkpoint
+            std::vector<size_t> resume_;
+            std::vector<size_t> exact_from_;
+        };
+        auto plan(const Graph &g, const std::vector<NodeId> &outputs, const size_t bars, const size_t start = 0,
+                  const size_t fin = all_bars, const WarmCache *cache = nullptr) -> Plan;
+
+        /* Bars a recursive average with this smoothing needs before its first output for the seed to have decayed
+         * below float precision */
+        auto warm_up(const Node &node) -> size_t;
+
+        /* Calculates the outputs over bars [start, fin). Nodes on the same level of the plan don't depend on each
+         * other so each level is run in parallel. Only the visible bars plus each indicator's warm up are touched,
+         * with a cache the warm up is replaced by the nearest checkpoint */
+        auto evaluate(const Graph &g, const TSData &in, const std::vector<NodeId> &outputs, const size_t start = 0,
+                      const size_t fin = all_bars) -> std::vector<Series>;
+        auto evaluate(const Graph &g, const TSData &in, const std::vector<NodeId> &outputs, const size_t start,
+                      const size_t fin, WarmCache &cache) -> std::vector<Series>;
+
+        // Bar range [start, fin) covering the timestamps a chart is showing
+        auto visible_range(const TSData &in, const size_t ts_start, const size_t ts_end) -> std::pair<size_t, size_t>;
+    } // namespace IndicatorGraph
+} // namespace AARC
@@ -0,0 +1,189 @@
+#include "Lattice.h"
+#include "BlackScholes.h"
+#include "Split.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+namespace {
+    using namespace AARC::Lattice;
+
+    // Steps (0 is today) where the option can be exercised before expiry
+    auto exercise_steps(const Option &option, const size_t steps) -> std::vector<bool> {
+        using namespace std;
+        auto out = vector<bool>(steps, option.exercise_ == Exercise::AMERICAN);
+        if (option.exercise_ == Exercise::BERMUDAN) {
+            const auto dates = max<size_t>(option.exercise_dates_, 1);
+            for (auto m = size_t(1); m < dates; ++m) {
+                const auto step = static_cast<size_t>(llround(double(m) * steps / dates));
+                if (step < steps) out[step] = true;
+            }
+        }
+        return out;
+    }
+
+    // Delta and gamma from three neighbouring nodes
+    auto greeks(const double *values, const double *spots, Result &out) -> void {
+        const auto up   = (values[2] - values[1]) / (spots[2] - spots[1]);
+        const auto down = (values[1] - values[0]) / (spots[1] - spots[0]);
+        out.delta_      = (values[2] - values[0]) / (spots[2] - spots[0]);
+        out.gamma_      = (up - down) / (0.5 * (spots[2] - spots[0]));
+    }
+
+    auto binomial(const Model &model, const Option &option, const size_t steps, std::vector<double> &values,
+                  std::vector<double> &spots) -> Result {
+        using namespace std;
+        const auto dt     = option.expiry_ / steps;
+        const auto up     = exp(model.vol_ * sqrt(dt));
+        const auto p      = (exp((model.rate_ - model.dividend_) * dt) - 1.0 / up) / (up - 1.0 / up);
+        const auto disc   = exp(-model.rate_ * dt);
+        const auto sign   = option.call_ ? 1.0 : -1.0;
+        const auto call   = static_cast<int8_t>(option.call_ ? 1 : 0);
+        const auto early  = exercise_steps(option, steps);
+        values.resize(steps + 1);
+        spots.resize(steps + 1);
+        for (auto j = size_t(0); j <= steps; ++j) {
+            spots[j]  = model.spot_ * pow(up, 2.0 * j - double(steps));
+            values[j] = max(sign * (spots[j] - option.strike_), 0.0);
+        }
+        auto out = Result();
+        for (auto i = steps; i-- > 0;) {
+            ispc::binomial_step(values.data(), spots.data(), i + 1, disc * (1.0 - p), disc * p, up, option.strike_,
+                                call, early[i]);
+            // Gamma from the three nodes two steps in, delta from the two one step in which straddle today's spot
+            if (i == 2) greeks(values.data(), spots.data(), out);
+            if (i == 1) out.delta_ = (values[1] - values[0]) / (spots[1] - spots[0]);
+        }
+        out.price_ = values[0];
+        return out;
+    }
+
+    auto trinomial(const Model &model, const Option &option, const size_t steps, std::vector<double> &values,
+                   std::vector<double> &spots) -> Result {
+        using namespace std;
+        const auto dt    = option.expiry_ / steps;
+        const auto var   = model.vol_ * model.vol_;
+        const auto dx    = model.vol_ * sqrt(3.0 * dt);
+        const auto nu    = model.rate_ - model.dividend_ - 0.5 * var;
+        const auto a     = (var * dt + nu * nu * dt * dt) / (dx * dx);
+        const auto b     = nu * dt / dx;
+        const auto disc  = exp(-model.rate_ * dt);
+        const auto sign  = option.call_ ? 1.0 : -1.0;
+        const auto call  = static_cast<int8_t>(option.call_ ? 1 : 0);
+        const auto early = exercise_steps(option, steps);
+        values.resize(2 * steps + 1);
+        spots.resize(2 * steps + 1);
+        for (auto j = size_t(0); j <= 2 * steps; ++j) {
+            spots[j]  = model.spot_ * exp((double(j) - double(steps)) * dx);
+            values[j] = max(sign * (spots[j] - option.strike_), 0.0);
+        }
+        auto out = Result();
+        for (auto i = steps; i-- > 0;) {
+            ispc::trinomial_step(values.data(), spots.data(), 2 * i + 1, disc * 0.5 * (a - b), disc * (1.0 - a),
+                                 disc * 0.5 * (a + b), option.strike_, call, early[i]);
+            if (i == 1) greeks(values.data(), spots.data(), out);
+        }
+        out.price_ = values[0];
+        return out;
+    }
+
+    auto value(const Model &model, const Option &option, const Settings &settings, std::vector<double> &values,
+               std::vector<double> &spots) -> Result {
+        const auto steps = std::max<size_t>(settings.steps_, 2);
+        if (option.expiry_ <= 0.0) {
+            const auto sign = option.call_ ? 1.0 : -1.0;
+            return Result{std::max(sign * (model.spot_ - option.strike_), 0.0), 0.0, 0.0};
+        }
+        return settings.tree_ == Tree::BINOMIAL ? binomial(model, option, steps, values, spots)
+                                                : trinomial(model, option, steps, values, spots);
+    }
+} // namespace
+
+auto AARC::Lattice::price(const Model &model, const Option &option, const Settings &settings) -> Result {
+    auto values = std::vector<double>(), spots = std::vector<double>();
+    return value(model, option, settings, values, spots);
+}
+
+auto AARC::Lattice::price(const Model &model, const std::vector<Option> &options, const Settings &settings)
+    -> std::vector<Result> {
+    const auto sz  = options.size();
+    auto       out = std::vector<Result>(sz);
+    // A task prices a handful of options, reusing its two slice buffers for each
+    const auto chunk = size_t(8);
+    concurrency::parallel_for(size_t(0), (sz + chunk - 1) / chunk, [&](const size_t c) {
+        auto values = std::vector<double>(), spots = std::vector<double>();
+        for (auto i = c * chunk; i < std::min(sz, (c + 1) * chunk); ++i) {
+            out[i] = value(model, options[i], settings, values, spots);
+        }
+    });
+    return out;
+}
+
+TEST_CASE("Lattice against Black-Scholes") {
+    using namespace AARC::Lattice;
+    const auto model = Model{100.0, 0.05, 0.02, 0.25};
+    for (const auto tree : {Tree::BINOMIAL, Tree::TRINOMIAL}) {
+        const auto settings = Settings{tree, 1000};
+        for (const auto call : {true, false}) {
+            for (const auto strike : {80.0, 100.0, 120.0}) {
+                const auto r  = price(model, Option{Exercise::EUROPEAN, call, strike, 0.75}, settings);
+                const auto bs = AARC::BlackScholes::value(100.0, strike, 0.25, 0.05, 0.02, 0.75, call);
+                CHECK(r.price_ == doctest::Approx(bs).epsilon(2e-3));
+                // Delta and gamma against differences of the closed form
+                const auto h  = 0.01;
+                const auto up = AARC::BlackScholes::value(100.0 + h, strike, 0.25, 0.05, 0.02, 0.75, call);
+                const auto dn = AARC::BlackScholes::value(100.0 - h, strike, 0.25, 0.05, 0.02, 0.75, call);
+                CHECK(r.delta_ == doctest::Approx((up - dn) / (2 * h)).epsilon(1e-2));
+                CHECK(r.gamma_ == doctest::Approx((up - 2 * bs + dn) / (h * h)).epsilon(5e-2));
+            }
+        }
+    }
+}
+
+TEST_CASE("Lattice early exercise") {
+    using namespace AARC::Lattice;
+    // American put benchmark S = K = 40, r = 6%, vol 20%, one year is 2.3141 (Longstaff-Schwartz table 1)
+    const auto model    = Model{40.0, 0.06, 0.0, 0.2};
+    const auto american = Option{Exercise::AMERICAN, false, 40.0, 1.0};
+    const auto binomial = price(model, american, Settings{Tree::BINOMIAL, 2000});
+    const auto trinom   = price(model, american, Settings{Tree::TRINOMIAL, 1000});
+    CHECK(binomial.price_ == doctest::Approx(2.314).epsilon(2e-3));
+    CHECK(trinom.price_ == doctest::Approx(binomial.price_).epsilon(2e-3));
+
+    // Bermudan sits between European and American, more dates move it towards American
+    const auto european = price(model, Option{Exercise::EUROPEAN, false, 40.0, 1.0}).price_;
+    const auto few      = price(model, Option{Exercise::BERMUDAN, false, 40.0, 1.0, 4}).price_;
+    const auto many     = price(model, Option{Exercise::BERMUDAN, false, 40.0, 1.0, 50}).price_;
+    const auto amer     = price(model, american).price_;
+    CHECK(european < few);
+    CHECK(few < many);
+    CHECK(many < amer);
+
+    // Without dividends an American call is never exercised early
+    const auto call = price(model, Option{Exercise::AMERICAN, true, 40.0, 1.0});
+    CHECK(call.price_ == doctest::Approx(price(model, Option{Exercise::EUROPEAN, true, 40.0, 1.0}).price_));
+
+    // Batch pricing gives the single option prices
+    auto options = std::vector<Option>();
+    for (auto k = 30.0; k <= 50.0; k += 1.0) options.emplace_back(Option{Exercise::AMERICAN, false, k, 0.5});
+    const auto batch = price(model, options);
+    REQUIRE(batch.size() == options.size());
+    for (auto i = size_t(0); i < options.size(); ++i) CHECK(batch[i].price_ == price(model, options[i]).price_);
+}
+
+TEST_CASE("Lattice benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::Lattice;
+    using namespace std::chrono;
+    auto options = std::vector<Option>();
+    for (auto i = 0; i < 1000; ++i) {
+        options.emplace_back(Option{Exercise::AMERICAN, i % 2 == 0, 80.0 + i % 40, 0.25 + 0.25 * (i % 8)});
+    }
+    const auto start   = high_resolution_clock::now();
+    const auto results = price(Model{100.0, 0.03, 0.01, 0.3}, options, Settings{Tree::BINOMIAL, 1000});
+    const auto us      = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    CHECK(results.size() == options.size());
+    spdlog::get("logger")->info("Lattice 1000 American options 1000 steps {}us", us);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace AARC {
+    namespace Lattice {
+        /* Binomial (Cox-Ross-Rubinstein) and trinomial trees for early exercise, where Monte Carlo struggles. Each
+        time slice is a contiguous vector and backward induction runs a whole slice at a time in SIMD, in place in
+        one value and one spot buffer. A batch of options is priced across cores, one tree per option */
+
+        enum class Tree { BINOMIAL, TRINOMIAL };
+        enum class Exercise { EUROPEAN, AMERICAN, BERMUDAN };
+
+        struct Option {
+            Exercise exercise_ = Exercise::AMERICAN;
+            bool     call_     = false;
+            double   strike_   = 100.0;
+            double   expiry_   = 1.0; // Years
+            // Bermudan only, evenly spaced exercise dates with the last one at expiry
+            size_t exercise_dates_ = 1;
+        };
+
+        struct Model {
+            double spot_     = 100.0;
+            double rate_     = 0.0;
+            double dividend_ = 0.0;
+            double vol_      = 0.2;
+        };
+
+        struct Settings {
+            Tree   tree_  = Tree::BINOMIAL;
+            size_t steps_ = 500; // At least 2
+        };
+
+        // Delta and gamma come off the first slices of the tree
+        struct Result {
+            double price_ = 0.0;
+            double delta_ = 0.0;
+            double gamma_ = 0.0;
+        };
+
+        auto price(const Model &model, const Option &option, const Settings &settings = Settings()) -> Result;
+
+        // Results in the same order as the options
+        auto price(const Model &model, const std::vector<Option> &options, const Settings &settings = Settings())
+            -> std::vector<Result>;
+    } // namespace Lattice
+} // namespace AARC
@@ -47,6 +47,7 @@ int main(int argc, char **argv) {
     logger->debug("Starting tests");
     doctest::Context ctx;
     ctx.setOption("abort-after", 5); // default - stop after 5 failed asserts
+    // Timings are in the "benchmark" suite and skipped, run them with --no-skip -ts=benchmark
     ctx.applyCommandLine(argc, argv);
     int res = ctx.run(); // run test cases unless with --no-run
     logger->flush();
@@ -0,0 +1,530 @@
+#include "MonteCarlo.h"
+#include "BlackScholes.h"
+#include "BrownianBridge.h"
+#include "Random.h"
+#include "Split.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <map>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+namespace {
+    using namespace AARC::MonteCarlo;
+
+    // The vol surface cut at the start of each step, so the path kernel only interpolates in spot
+    struct VolSlices {
+        std::vector<double> spots_;
+        std::vector<double> vols_;
+        size_t              nodes_ = 1;
+    };
+
+    auto vol_slices(const Model &model, const size_t steps, const double dt) -> VolSlices {
+        using namespace std;
+        const auto &lv = model.local_vol_;
+        if (lv.times_.empty() || lv.spots_.empty()) {
+            return VolSlices{{model.spot_}, vector<double>(steps, model.vol_), 1};
+        }
+        const auto nodes = lv.spots_.size();
+        auto       out   = VolSlices{lv.spots_, vector<double>(steps * nodes), nodes};
+        for (auto step = size_t(0); step < steps; ++step) {
+            const auto t  = step * dt;
+            const auto hi = static_cast<size_t>(upper_bound(begin(lv.times_), end(lv.times_), t) - begin(lv.times_));
+            const auto lo = hi == 0 ? 0 : hi - 1;
+            const auto up = min(hi, lv.times_.size() - 1);
+            const auto w  = up == lo ? 0.0 : (t - lv.times_[lo]) / (lv.times_[up] - lv.times_[lo]);
+            for (auto i = size_t(0); i < nodes; ++i) {
+                out.vols_[step * nodes + i] = (1.0 - w) * lv.vols_[lo * nodes + i] + w * lv.vols_[up * nodes + i];
+            }
+        }
+        return out;
+    }
+
+    /* Normals for count paths starting at path first, the leading bridge dimensions from Sobol points (skipping
+    the origin) and the rest from the block's random stream, turned into steps x count increments in z */
+    auto quasi_random_normals(const AARC::Sobol::Directions &sobol, const AARC::BrownianBridge::Bridge &bridge,
+                              const size_t first, AARC::Random::Stream &stream, double *z, const size_t count) -> void {
+        using namespace std;
+        const auto steps   = bridge.steps_;
+        const auto dims    = min(steps, sobol.dims_);
+        auto       normals = vector<double>(count * steps);
+        if (dims < steps) AARC::Random::normal(stream, normals.data(), normals.size());
+        if (dims > 0) {
+            auto points = vector<float>(count * sobol.dims_);
+            auto gen    = AARC::Sobol::generator(sobol, first + 1);
+            AARC::Sobol::next(gen, points.data(), count);
+            // Past 2^24 points a coordinate can round down to 0
+            for (auto &u : points) u = max(u, 1.0f / 33554432.0f);
+            ispc::inverse_normal_float(points.data(), points.size());
+            for (auto p = size_t(0); p < count; ++p) {
+                const auto point = begin(points) + p * sobol.dims_;
+                copy(point, point + dims, begin(normals) + p * steps);
+            }
+        }
+        AARC::BrownianBridge::increments(bridge, normals.data(), z, count);
+    }
+
+    auto norm_cdf(const double x) { return 0.5 * std::erfc(-x / std::sqrt(2.0)); }
+
+    // Closed forms under flat vol, the expectations of the control variates
+    auto black_scholes(const Model &m, const Option &o) {
+        return AARC::BlackScholes::value(m.spot_, o.strike_, m.vol_, m.rate_, m.dividend_, o.expiry_, o.call_);
+    }
+
+    // Discretely monitored geometric average over the steps dates, the log of the average is normal
+    auto geometric_asian(const Model &m, const Option &o, const size_t steps) {
+        const auto dt   = o.expiry_ / steps;
+        const auto n    = static_cast<double>(steps);
+        const auto mean = std::log(m.spot_) + (m.rate_ - m.dividend_ - 0.5 * m.vol_ * m.vol_) * dt * (n + 1) / 2;
+        const auto var  = m.vol_ * m.vol_ * dt * (n + 1) * (2 * n + 1) / (6 * n);
+        const auto d1   = (mean - std::log(o.strike_) + var) / std::sqrt(var);
+        const auto df   = std::exp(-m.rate_ * o.expiry_);
+        return o.call_ ? df * (std::exp(mean + var / 2) * norm_cdf(d1) - o.strike_ * norm_cdf(d1 - std::sqrt(var)))
+                       : df * (o.strike_ * norm_cdf(std::sqrt(var) - d1) - std::exp(mean + var / 2) * norm_cdf(-d1));
+    }
+    /* Sums of one option's discounted payoffs y, and its control variate's x, over one block. Added up across blocks
+     * in block order */
+    struct Moments {
+        double sum_    = 0.0;
+        double sum_sq_ = 0.0;
+        double x_      = 0.0;
+        double x_sq_   = 0.0;
+        double xy_     = 0.0;
+    };
+
+    auto add(Moments &m, const Moments &other) -> void {
+        m.sum_ += other.sum_, m.sum_sq_ += other.sum_sq_;
+        m.x_ += other.x_, m.x_sq_ += other.x_sq_, m.xy_ += other.xy_;
+    }
+
+    auto to_result(const Moments &m, const size_t n) -> Result {
+        const auto mean = m.sum_ / n;
+        const auto var  = n > 1 ? std::max(0.0, (m.sum_sq_ - n * mean * mean) / (n - 1)) : 0.0;
+        return Result{mean, std::sqrt(var / n), n};
+    }
+
+    /* Control variate estimate y - beta (x - E[x]) with beta = cov(x, y) / var(x) from the same samples, the
+     * variance left is var(y) (1 - corr(x, y)^2) */
+    auto to_result(const Moments &m, const size_t n, const double expected) -> Result {
+        const auto y   = m.sum_ / n, x = m.x_ / n;
+        const auto sxx = m.x_sq_ - n * x * x, syy = m.sum_sq_ - n * y * y, sxy = m.xy_ - n * x * y;
+        if (n < 3 || sxx <= 0.0) return to_result(m, n);
+        const auto beta = sxy / sxx;
+        const auto var  = std::max(0.0, (syy - beta * sxy) / (n - 2));
+        return Result{y - beta * (x - expected), std::sqrt(var / n), n};
+    }
+
+    // Rescales each step's normals to mean 0 and variance 1 over the paths of the block
+    auto match_moments(double *z, const size_t steps, const size_t count) -> void {
+        for (auto step = size_t(0); step < steps; ++step) {
+            auto *row  = z + step * count;
+            auto  mean = 0.0, sq = 0.0;
+            for (auto p = size_t(0); p < count; ++p) mean += row[p], sq += row[p] * row[p];
+            mean /= count;
+            const auto sd = std::sqrt(std::max(sq / count - mean * mean, 1e-300));
+            for (auto p = size_t(0); p < count; ++p) row[p] = (row[p] - mean) / sd;
+        }
+    }
+
+    auto payoff_kind(const Payoff payoff) -> int {
+        switch (payoff) {
+        case Payoff::ASIAN_ARITHMETIC: return 1;
+        case Payoff::ASIAN_GEOMETRIC: return 2;
+        default: return 0;
+        }
+    }
+
+    // Solves the 3x3 normal equations by elimination with partial pivoting, false if they are singular
+    auto solve3(std::array<std::array<double, 4>, 3> m, std::array<double, 3> &x) -> bool {
+        for (auto c = 0; c < 3; ++c) {
+            auto pivot = c;
+            for (auto r = c + 1; r < 3; ++r) {
+                if (std::abs(m[r][c]) > std::abs(m[pivot][c])) pivot = r;
+            }
+            if (std::abs(m[pivot][c]) < 1e-12) return false;
+            std::swap(m[c], m[pivot]);
+            for (auto r = c + 1; r < 3; ++r) {
+                const auto f = m[r][c] / m[c][c];
+                for (auto k = c; k < 4; ++k) m[r][k] -= f * m[c][k];
+            }
+        }
+        for (auto r = 2; r >= 0; --r) {
+            auto v = m[r][3];
+            for (auto k = r + 1; k < 3; ++k) v -= m[r][k] * x[k];
+            x[r] = v / m[r][r];
+        }
+        return true;
+    }
+
+    /* Longstaff and Schwartz least squares Monte Carlo. Working back from expiry, at each exercise date the
+    discounted cash flows of the in the money paths are regressed on 1, S/K and (S/K)^2, and a path exercises where
+    the immediate payoff beats the fitted continuation value. paths holds every block's (steps + 1) x block matrix */
+    auto longstaff_schwartz(const std::vector<std::vector<double>> &paths, const size_t block, const size_t steps,
+                            const double dt, const double rate, const Option &option, const bool antithetic)
+        -> Result {
+        using namespace std;
+        const auto exercise = [&option](const double s) {
+            return max(option.call_ ? s - option.strike_ : option.strike_ - s, 0.0);
+        };
+        const auto dates = max(size_t(1), min(option.exercise_dates_, steps));
+        auto       at    = vector<size_t>(dates);
+        for (auto k = size_t(0); k < dates; ++k) at[k] = (k + 1) * steps / dates;
+
+        // Cash flow of each path, discounted to the exercise date being looked at
+        auto cash = vector<vector<double>>(paths.size(), vector<double>(block));
+        concurrency::parallel_for(size_t(0), paths.size(), [&](const size_t b) {
+            for (auto p = size_t(0); p < block; ++p) cash[b][p] = exercise(paths[b][steps * block + p]);
+        });
+        for (auto k = dates - 1; k-- > 0;) {
+            const auto step    = at[k];
+            const auto df      = exp(-rate * (at[k + 1] - step) * dt);
+            auto       partial = vector<array<double, 8>>(paths.size());
+            concurrency::parallel_for(size_t(0), paths.size(), [&](const size_t b) {
+                auto &sums = partial[b];
+                sums.fill(0.0);
+                for (auto p = size_t(0); p < block; ++p) {
+                    cash[b][p] *= df;
+                    const auto s = paths[b][step * block + p];
+                    if (exercise(s) <= 0.0) continue;
+                    const auto x = s / option.strike_, y = cash[b][p];
+                    sums[0] += 1.0, sums[1] += x, sums[2] += x * x, sums[3] += x * x * x, sums[4] += x * x * x * x;
+                    sums[5] += y, sums[6] += x * y, sums[7] += x * x * y;
+                }
+            });
+            auto sums = array<double, 8>();
+            sums.fill(0.0);
+            for (const auto &s : partial) {
+                for (auto i = size_t(0); i < sums.size(); ++i) sums[i] += s[i];
+            }
+            auto beta = array<double, 3>();
+            if (!solve3({{{{sums[0], sums[1], sums[2], sums[5]}},
+                          {{sums[1], sums[2], sums[3], sums[6]}},
+                          {{sums[2], sums[3], sums[4], sums[7]}}}},
+                        beta))
+                continue;
+            concurrency::parallel_for(size_t(0), paths.size(), [&](const size_t b) {
+                for (auto p = size_t(0); p < block; ++p) {
+                    const auto s   = paths[b][step * block + p];
+                    const auto now = exercise(s);
+                    if (now <= 0.0) continue;
+                    const auto x = s / option.strike_;
+                    if (now > beta[0] + beta[1] * x + beta[2] * x * x) cash[b][p] = now;
+                }
+            });
+        }
+        // Antithetic pairs are one sample
+        const auto df      = exp(-rate * at[0] * dt);
+        const auto samples = antithetic ? block / 2 : block;
+        auto       m       = Moments();
+        for (const auto &c : cash) {
+            for (auto p = size_t(0); p < samples; ++p) {
+                const auto v = df * (antithetic ? 0.5 * (c[p] + c[p + samples]) : c[p]);
+                m.sum_ += v, m.sum_sq_ += v * v;
+            }
+        }
+        return to_result(m, paths.size() * samples);
+    }
+} // namespace
+
+auto AARC::MonteCarlo::price(const Model &model, const Option &option, const Settings &settings) -> Result {
+    return price(model, std::vector<Option>{option}, settings).front();
+}
+
+auto AARC::MonteCarlo::price(const Model &model, const std::vector<Option> &options, const Settings &settings)
+    -> std::vector<Result> {
+    using namespace std;
+    MethodLogger mlog("MonteCarlo::price");
+    auto         results = vector<Result>(options.size());
+    // Antithetic blocks are pairs of half blocks
+    const auto  block = settings.antithetic_ ? settings.block_ & ~size_t(1) : settings.block_;
+    const auto  drawn = settings.antithetic_ ? block / 2 : block;
+    if (options.empty()) return results;
+    if (settings.paths_ == 0 || drawn == 0 || settings.steps_ == 0) {
+        mlog.logger()->error("{} paths in blocks of {} over {} steps", settings.paths_, settings.block_,
+                             settings.steps_);
+        return results;
+    }
+    const auto  blocks  = (settings.paths_ + block - 1) / block;
+    const auto  steps   = settings.steps_;
+    const auto  builtin = settings.quasi_random_ && !settings.directions_
+                             ? AARC::Sobol::directions(min<size_t>(steps, 40))
+                             : AARC::Sobol::Directions();
+    const auto &sobol   = settings.directions_ ? *settings.directions_ : builtin;
+    // Under local vol the controls are valued on Black-Scholes paths made from the same normals
+    const auto  local   = !model.local_vol_.times_.empty() && !model.local_vol_.spots_.empty();
+    const auto  shadow  = settings.control_variate_ && local;
+    auto        flat    = model;
+    flat.local_vol_     = LocalVol();
+
+    auto by_expiry = map<double, vector<size_t>>();
+    for (auto i = size_t(0); i < options.size(); ++i) by_expiry[options[i].expiry_].emplace_back(i);
+
+    for (const auto &group : by_expiry) {
+        const auto  expiry   = group.first;
+        const auto &members  = group.second;
+        const auto  dt       = expiry / steps;
+        const auto  slices   = vol_slices(model, steps, dt);
+        const auto  flat_vol = vol_slices(flat, steps, dt);
+        const auto  discount = exp(-model.rate_ * expiry);
+        const auto  lsm      = any_of(begin(members), end(members),
+                                [&options](const size_t i) { return options[i].payoff_ == Payoff::BERMUDAN; });
+        const auto  bridge   = settings.quasi_random_ ? AARC::BrownianBridge::build(steps, expiry)
+                                                      : AARC::BrownianBridge::Bridge();
+        auto kept    = vector<vector<double>>(lsm ? blocks : 0);
+        auto moments = vector<Moments>(blocks * members.size());
+
+        concurrency::parallel_for(size_t(0), blocks, [&](const size_t b) {
+            auto z       = vector<double>(steps * block);
+            auto paths   = vector<double>((steps + 1) * block);
+            auto control = vector<double>(shadow ? (steps + 1) * block : 0);
+            auto y       = vector<double>(block);
+            auto x       = vector<double>(block);
+            auto stream  = AARC::Random::Stream{settings.seed_, b};
+            auto normals = settings.antithetic_ ? vector<double>(steps * drawn) : vector<double>();
+            auto *draw   = settings.antithetic_ ? normals.data() : z.data();
+            if (settings.quasi_random_) {
+                quasi_random_normals(sobol, bridge, b * drawn, stream, draw, drawn);
+            } else {
+                AARC::Random::normal(stream, draw, steps * drawn);
+            }
+            if (settings.antithetic_) {
+                for (auto step = size_t(0); step < steps; ++step) {
+                    const auto row = begin(normals) + step * drawn;
+                    copy(row, row + drawn, begin(z) + step * block);
+                    transform(row, row + drawn, begin(z) + step * block + drawn, [](const double v) { return -v; });
+                }
+            }
+            if (settings.moment_matching_) match_moments(z.data(), steps, block);
+            const auto carry = model.rate_ - model.dividend_;
+            ispc::local_vol_paths(z.data(), paths.data(), block, steps, model.spot_, carry, dt, slices.vols_.data(),
+                                  slices.spots_.data(), slices.nodes_);
+            if (shadow) {
+                ispc::local_vol_paths(z.data(), control.data(), block, steps, model.spot_, carry, dt,
+                                      flat_vol.vols_.data(), flat_vol.spots_.data(), flat_vol.nodes_);
+            }
+            const auto &control_paths = shadow ? control : paths;
+            for (auto j = size_t(0); j < members.size(); ++j) {
+                const auto &option = options[members[j]];
+                if (option.payoff_ == Payoff::BERMUDAN) continue;
+                ispc::path_payoffs(paths.data(), y.data(), block, steps, option.strike_, option.call_,
+                                   payoff_kind(option.payoff_), discount);
+                // Europeans are controlled by the same payoff under Black-Scholes, Asians by the geometric average
+                if (settings.control_variate_) {
+                    ispc::path_payoffs(control_paths.data(), x.data(), block, steps, option.strike_, option.call_,
+                                       option.payoff_ == Payoff::EUROPEAN ? 0 : 2, discount);
+                }
+                auto &m = moments[b * members.size() + j];
+                for (auto p = size_t(0); p < drawn; ++p) {
+                    const auto yv = settings.antithetic_ ? 0.5 * (y[p] + y[p + drawn]) : y[p];
+                    const auto xv = settings.antithetic_ ? 0.5 * (x[p] + x[p + drawn]) : x[p];
+                    m.sum_ += yv, m.sum_sq_ += yv * yv;
+                    m.x_ += xv, m.x_sq_ += xv * xv, m.xy_ += xv * yv;
+                }
+            }
+            if (lsm) kept[b] = move(paths);
+        });
+
+        for (auto j = size_t(0); j < members.size(); ++j) {
+            const auto &option = options[members[j]];
+            if (option.payoff_ == Payoff::BERMUDAN) {
+                results[members[j]] =
+                    longstaff_schwartz(kept, block, steps, dt, model.rate_, option, settings.antithetic_);
+                continue;
+            }
+            auto total = Moments();
+            for (auto b = size_t(0); b < blocks; ++b) add(total, moments[b * members.size() + j]);
+            if (!settings.control_variate_) {
+                results[members[j]] = to_result(total, blocks * drawn);
+                continue;
+            }
+            const auto expected = option.payoff_ == Payoff::EUROPEAN ? black_scholes(flat, option)
+                                                                     : geometric_asian(flat, option, steps);
+            results[members[j]] = to_result(total, blocks * drawn, expected);
+        }
+    }
+    return results;
+}
+
+auto AARC::MonteCarlo::paths_for_error(const Result &result, const double target) -> size_t {
+    if (target <= 0.0) return 0;
+    return static_cast<size_t>(std::ceil(result.paths_ * (result.std_error_ / target) * (result.std_error_ / target)));
+}
+
+TEST_CASE("Monte Carlo against closed forms") {
+    using namespace AARC::MonteCarlo;
+    const auto model    = Model{100.0, 0.05, 0.01, 0.25};
+    auto       settings = Settings();
+    settings.paths_     = 1 << 17;
+    settings.steps_     = 16;
+    auto options        = std::vector<Option>();
+    for (const auto strike : {80.0, 100.0, 120.0}) {
+        options.emplace_back(Option{Payoff::EUROPEAN, true, strike, 1.0});
+        options.emplace_back(Option{Payoff::EUROPEAN, false, strike, 0.5});
+        options.emplace_back(Option{Payoff::ASIAN_GEOMETRIC, true, strike, 1.0});
+        options.emplace_back(Option{Payoff::ASIAN_ARITHMETIC, true, strike, 1.0});
+    }
+    const auto results = price(model, options, settings);
+    for (auto i = size_t(0); i < options.size(); ++i) {
+        const auto &o = options[i];
+        const auto &r = results[i];
+        CHECK(r.paths_ == settings.paths_);
+        if (o.payoff_ == Payoff::EUROPEAN) CHECK(std::abs(r.price_ - black_scholes(model, o)) < 4 * r.std_error_);
+        if (o.payoff_ == Payoff::ASIAN_GEOMETRIC) {
+            CHECK(std::abs(r.price_ - geometric_asian(model, o, settings.steps_)) < 4 * r.std_error_);
+            // Arithmetic average is never below the geometric one
+            CHECK(results[i + 1].price_ > r.price_);
+        }
+    }
+    // Same numbers again, whatever order the blocks ran in
+    CHECK(price(model, options[3], settings).price_ == results[3].price_);
+
+    // A flat local vol surface is the same model
+    auto local       = model;
+    local.local_vol_ = LocalVol{{0.0, 1.0}, {50.0, 150.0}, {0.25, 0.25, 0.25, 0.25}};
+    CHECK(price(local, options[0], settings).price_ == doctest::Approx(results[0].price_).epsilon(1e-12));
+    // Skew lifts the low strike put
+    local.local_vol_.vols_ = {0.35, 0.15, 0.35, 0.15};
+    CHECK(price(local, options[1], settings).price_ > results[1].price_);
+
+    // No paths is an error, not a NaN price
+    settings.paths_ = 0;
+    const auto none = price(model, options[0], settings);
+    CHECK(none.price_ == 0.0);
+    CHECK(none.paths_ == 0);
+}
+
+TEST_CASE("Monte Carlo Bermudan") {
+    using namespace AARC::MonteCarlo;
+    // Longstaff and Schwartz's first example, American put 4.478 by finite differences
+    const auto model    = Model{36.0, 0.06, 0.0, 0.2};
+    auto       settings = Settings();
+    settings.paths_     = 100000;
+    settings.steps_     = 50;
+    const auto put      = Option{Payoff::BERMUDAN, false, 40.0, 1.0, 50};
+    const auto r        = price(model, put, settings);
+    CHECK(r.price_ == doctest::Approx(4.472).epsilon(0.01));
+    CHECK(r.std_error_ < 0.01);
+    const auto european = price(model, Option{Payoff::BERMUDAN, false, 40.0, 1.0, 1}, settings);
+    CHECK(european.price_ == doctest::Approx(black_scholes(model, put)).epsilon(0.01));
+}
+
+TEST_CASE("Monte Carlo quasi random paths") {
+    using namespace AARC::MonteCarlo;
+    const auto model  = Model{100.0, 0.05, 0.0, 0.3};
+    const auto asian  = Option{Payoff::ASIAN_GEOMETRIC, true, 100.0, 1.0};
+    auto       pseudo = Settings();
+    pseudo.steps_     = 64;
+    auto quasi        = pseudo;
+    quasi.quasi_random_ = true;
+    const auto exact    = geometric_asian(model, asian, pseudo.steps_);
+
+    // Error against the closed form as the path count grows, 64 steps so 24 of the bridge dimensions are pseudo random
+    for (const auto paths : {size_t(1) << 12, size_t(1) << 14, size_t(1) << 16}) {
+        pseudo.paths_ = quasi.paths_ = paths;
+        const auto p  = price(model, asian, pseudo);
+        CHECK(std::abs(price(model, asian, quasi).price_ - exact) < 4 * p.std_error_);
+    }
+    // At 2^16 paths the quasi random price is well inside the pseudo random standard error
+    CHECK(std::abs(price(model, asian, quasi).price_ - exact) < 0.25 * price(model, asian, pseudo).std_error_);
+}
+
+TEST_CASE("Monte Carlo variance reduction") {
+    using namespace AARC::MonteCarlo;
+    using namespace std::chrono;
+    const auto model = Model{100.0, 0.04, 0.0, 0.3};
+    auto       book  = std::vector<Option>();
+    for (const auto strike : {90.0, 100.0, 110.0}) {
+        book.emplace_back(Option{Payoff::ASIAN_ARITHMETIC, true, strike, 1.0});
+    }
+    auto base   = Settings();
+    base.paths_ = 1 << 15;
+    base.steps_ = 32;
+
+    struct Case {
+        const char *name_;
+        bool        antithetic_, moment_matching_, control_variate_;
+    };
+    const auto cases  = {Case{"plain", false, false, false}, Case{"antithetic", true, false, false},
+                        Case{"moment matching", false, true, false}, Case{"control variate", false, false, true},
+                        Case{"all", true, true, true}};
+    const auto target = 0.001;
+    auto       plain  = std::vector<Result>();
+    for (const auto &c : cases) {
+        auto settings             = base;
+        settings.antithetic_      = c.antithetic_;
+        settings.moment_matching_ = c.moment_matching_;
+        settings.control_variate_ = c.control_variate_;
+        const auto start          = high_resolution_clock::now();
+        const auto results        = price(model, book, settings);
+        const auto us             = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+        if (plain.empty()) plain = results;
+        for (auto i = size_t(0); i < book.size(); ++i) {
+            const auto &r = results[i];
+            // Still the same price
+            CHECK(std::abs(r.price_ - plain[i].price_) < 4 * plain[i].std_error_);
+            // Paths simulated and CPU time to the target error, scaled from this run. An antithetic sample is two
+            const auto samples = paths_for_error(r, target);
+            const auto needed  = c.antithetic_ ? 2 * samples : samples;
+            spdlog::get("logger")->info("Asian K={} {}: {} paths for {} error, {:.0f}ms", book[i].strike_, c.name_,
+                                        needed, target, us / 1000.0 * samples / r.paths_ / book.size());
+            if (c.control_variate_) CHECK(needed * 20 < paths_for_error(plain[i], target));
+            if (c.antithetic_ && !c.control_variate_) CHECK(needed < paths_for_error(plain[i], target));
+        }
+    }
+
+    // Under local vol the controls run on Black-Scholes paths alongside
+    auto local       = model;
+    local.local_vol_ = LocalVol{{0.0, 1.0}, {60.0, 100.0, 140.0}, {0.4, 0.3, 0.25, 0.38, 0.28, 0.24}};
+    auto settings    = base;
+    const auto lv    = price(local, book, settings);
+    settings.control_variate_ = true;
+    const auto lv_cv          = price(local, book, settings);
+    for (auto i = size_t(0); i < book.size(); ++i) {
+        CHECK(std::abs(lv_cv[i].price_ - lv[i].price_) < 4 * lv[i].std_error_);
+        CHECK(lv_cv[i].std_error_ * 3 < lv[i].std_error_);
+    }
+}
+
+TEST_CASE("Monte Carlo benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::MonteCarlo;
+    using namespace std::chrono;
+    const auto model    = Model{100.0, 0.03, 0.0, 0.2};
+    auto       settings = Settings();
+    settings.paths_     = 1 << 14;
+    settings.steps_     = 32;
+    auto options        = std::vector<Option>();
+    for (auto expiry = 1; expiry <= 4; ++expiry) {
+        for (auto strike = 50; strike < 150; ++strike) {
+            options.emplace_back(Option{Payoff::EUROPEAN, strike % 2 == 0, double(strike), expiry * 0.25});
+            options.emplace_back(Option{Payoff::ASIAN_ARITHMETIC, strike % 2 == 0, double(strike), expiry * 0.25});
+        }
+    }
+    const auto start   = high_resolution_clock::now();
+    const auto results = price(model, options, settings);
+    const auto ms      = duration_cast<milliseconds>(high_resolution_clock::now() - start).count();
+    CHECK(results.size() == options.size());
+    spdlog::get("logger")->info("Monte Carlo {} options x {} paths in {}ms", options.size(), settings.paths_, ms);
+
+    // Pseudo random against Sobol points through the bridge, error and time as the path count grows
+    const auto asian  = Option{Payoff::ASIAN_GEOMETRIC, true, 100.0, 1.0};
+    auto       pseudo = Settings();
+    pseudo.steps_     = 64;
+    auto quasi        = pseudo;
+    quasi.quasi_random_ = true;
+    const auto exact    = geometric_asian(model, asian, pseudo.steps_);
+    for (const auto paths : {size_t(1) << 12, size_t(1) << 14, size_t(1) << 16}) {
+        pseudo.paths_ = quasi.paths_ = paths;
+        const auto begin = high_resolution_clock::now();
+        const auto p     = price(model, asian, pseudo);
+        const auto mid   = high_resolution_clock::now();
+        const auto q     = price(model, asian, quasi);
+        const auto fin   = high_resolution_clock::now();
+        spdlog::get("logger")->info("Asian {} paths pseudo error {:.5f} ({}ms) sobol + bridge error {:.5f} ({}ms)",
+                                    paths, std::abs(p.price_ - exact), duration_cast<milliseconds>(mid - begin).count(),
+                                    std::abs(q.price_ - exact), duration_cast<milliseconds>(fin - mid).count());
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "Sobol.h"
+#include <cstdint>
+#include <vector>
+
+namespace AARC {
+    namespace MonteCarlo {
+        /* Monte Carlo option pricing. Paths are simulated a block at a time in SoA layout (one row per time step,
+        one column per path) and every option sharing an expiry is valued off the same block before the next one is
+        made. Block b always draws from random stream b so the price is the same whatever the thread count */
+
+        enum class Payoff { EUROPEAN, ASIAN_ARITHMETIC, ASIAN_GEOMETRIC, BERMUDAN };
+
+        struct Option {
+            Payoff payoff_ = Payoff::EUROPEAN;
+            bool   call_   = true;
+            double strike_ = 100.0;
+            double expiry_ = 1.0; // Years
+            // Bermudan only, evenly spaced exercise dates with the last one at expiry
+            size_t exercise_dates_ = 1;
+        };
+
+        /* Local volatility surface, vols_[t * spots_.size() + s] is the vol at times_[t] and spots_[s]. Linear in
+         * both directions and flat outside the grid */
+        struct LocalVol {
+            std::vector<double> times_;
+            std::vector<double> spots_;
+            std::vector<double> vols_;
+        };
+
+        struct Model {
+            double   spot_     = 100.0;
+            double   rate_     = 0.0;
+            double   dividend_ = 0.0;
+            double   vol_      = 0.2; // Used when there is no local vol surface
+            LocalVol local_vol_;
+        };
+
+        struct Settings {
+            size_t   paths_ = 1 << 16; // Rounded up to whole blocks
+            size_t   steps_ = 64;      // Per option expiry, also the Asian averaging dates
+            size_t   block_ = 4096;    // Paths simulated together, part of what fixes the random numbers
+            uint64_t seed_  = 1;
+            /* Sobol points through a Brownian bridge instead of pseudo random normals. Bridge dimensions past the
+            Sobol table (40 built in, or directions_ from a Joe-Kuo file) are filled in pseudo randomly, they carry
+            little of the variance. std_error_ is still the sample error and overstates the quasi random error */
+            bool                     quasi_random_ = false;
+            const Sobol::Directions *directions_   = nullptr;
+
+            // Variance reduction, any combination
+            bool antithetic_      = false; // Second half of each block mirrors the first, a pair is one sample
+            bool moment_matching_ = false; // Each step's normals rescaled to mean 0 variance 1 over the block
+            /* Europeans are controlled by the Black-Scholes price of the same option, Asians by the closed form
+            geometric Asian. Under local vol the controls are priced on flat vol_ paths from the same normals, with a
+            flat model only the arithmetic Asian gains (the rest become exact) */
+            bool control_variate_ = false;
+        };
+
+        struct Result {
+            double price_     = 0.0;
+            double std_error_ = 0.0;
+            size_t paths_     = 0; // Independent samples, antithetic pairs count once
+        };
+
+        // Paths the same settings would need to bring the standard error down to target
+        auto paths_for_error(const Result &result, const double target) -> size_t;
+
+        auto price(const Model &model, const Option &option, const Settings &settings = Settings()) -> Result;
+
+        // Options with the same expiry are valued from one set of paths, results in the same order as the options
+        auto price(const Model &model, const std::vector<Option> &options, const Settings &settings = Settings())
+            -> std::vector<Result>;
+    } // namespace MonteCarlo
+} // namespace AARC
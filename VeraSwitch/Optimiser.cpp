@@ -0,0 +1,272 @@
+#include "Optimiser.h"
+#include "Covariance.h"
+#include "Random.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <numeric>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+namespace {
+    using namespace AARC::Optimiser;
+
+    auto feasible(const size_t n, const Constraints &c) {
+        return n > 0 && c.min_weight_ <= c.max_weight_ && n * c.min_weight_ <= 1.0 && n * c.max_weight_ >= 1.0;
+    }
+
+    // Nearest point to v that is fully invested and inside the weight limits, a shift found by bisection
+    auto project(const std::vector<double> &v, const Constraints &c, std::vector<double> &out) -> void {
+        using namespace std;
+        const auto invested = [&](const double shift) {
+            auto s = 0.0;
+            for (const auto x : v) s += min(max(x - shift, c.min_weight_), c.max_weight_);
+            return s;
+        };
+        auto lo = *min_element(begin(v), end(v)) - c.max_weight_, hi = *max_element(begin(v), end(v)) - c.min_weight_;
+        for (auto it = 0; it < 100 && hi - lo > 1e-15; ++it) {
+            const auto mid = 0.5 * (lo + hi);
+            if (invested(mid) > 1.0) lo = mid;
+            else hi = mid;
+        }
+        const auto shift = 0.5 * (lo + hi);
+        out.resize(v.size());
+        for (auto i = size_t(0); i < v.size(); ++i) out[i] = min(max(v[i] - shift, c.min_weight_), c.max_weight_);
+    }
+
+    auto multiply(const std::vector<double> &m, const std::vector<double> &x, std::vector<double> &y) -> void {
+        const auto n = x.size();
+        y.resize(n);
+        for (auto i = size_t(0); i < n; ++i) y[i] = AARC::dot(m.data() + i * n, x.data(), n);
+    }
+
+    // Largest eigenvalue of the covariance by power iteration, the gradient's Lipschitz constant
+    auto largest_eigenvalue(const std::vector<double> &cov, const size_t n) -> double {
+        auto x = std::vector<double>(n, 1.0 / std::sqrt(double(n))), y = std::vector<double>();
+        auto l = 0.0;
+        for (auto it = 0; it < 100; ++it) {
+            multiply(cov, x, y);
+            const auto norm = std::sqrt(AARC::dot(y.data(), y.data(), n));
+            if (norm == 0.0) return 0.0;
+            if (std::abs(norm - l) <= 1e-9 * norm) return norm;
+            l = norm;
+            for (auto i = size_t(0); i < n; ++i) x[i] = y[i] / norm;
+        }
+        return l;
+    }
+} // namespace
+
+auto AARC::Optimiser::estimate(const VaR::Returns &returns) -> Estimates {
+    using namespace std;
+    // Simple returns, a portfolio's return is the weighted sum of them
+    auto x = vector<double>(returns.r_.size());
+    transform(begin(returns.r_), end(returns.r_), begin(x), [](const double r) { return expm1(r); });
+    auto m = Covariance::sample(x.data(), returns.ts_.size(), returns.assets_.size());
+    return Estimates{move(m.mean_), move(m.cov_)};
+}
+
+auto AARC::Optimiser::mean_variance(const Estimates &estimates, const double risk_aversion,
+                                    const Constraints &constraints) -> Allocation {
+    using namespace std;
+    MethodLogger mlog("Optimiser::mean_variance");
+    const auto n = estimates.mean_.size();
+    if (!feasible(n, constraints) || estimates.cov_.size() != n * n) {
+        mlog.logger()->error("No portfolio of {} assets fits weights [{}, {}]", n, constraints.min_weight_,
+                             constraints.max_weight_);
+        return Allocation();
+    }
+    // Accelerated projected gradient (FISTA) on risk_aversion / 2 w'Cw - m'w
+    const auto &cov  = estimates.cov_;
+    const auto &mean = estimates.mean_;
+    const auto  step = 1.0 / max(risk_aversion * largest_eigenvalue(cov, n), 1e-12);
+    auto        w    = vector<double>(), y = vector<double>(), next = vector<double>(), g = vector<double>();
+    project(vector<double>(n, 1.0 / n), constraints, w);
+    y          = w;
+    auto theta = 1.0;
+    for (auto it = 0; it < 5000; ++it) {
+        multiply(cov, y, g);
+        for (auto i = size_t(0); i < n; ++i) g[i] = y[i] - step * (risk_aversion * g[i] - mean[i]);
+        project(g, constraints, next);
+        const auto theta_next = 0.5 * (1.0 + sqrt(1.0 + 4.0 * theta * theta));
+        auto       moved      = 0.0;
+        for (auto i = size_t(0); i < n; ++i) {
+            moved = max(moved, abs(next[i] - w[i]));
+            y[i]  = next[i] + (theta - 1.0) / theta_next * (next[i] - w[i]);
+        }
+        w.swap(next);
+        theta = theta_next;
+        if (moved < 1e-10) break;
+    }
+    multiply(cov, w, g);
+    return Allocation{w, dot(mean.data(), w.data(), n), sqrt(max(dot(g.data(), w.data(), n), 0.0))};
+}
+
+auto AARC::Optimiser::min_cvar(const VaR::Returns &returns, const double confidence, const double return_weight,
+                               const Constraints &constraints) -> Allocation {
+    using namespace std;
+    MethodLogger mlog("Optimiser::min_cvar");
+    const auto n = returns.assets_.size(), s = returns.ts_.size();
+    if (!feasible(n, constraints) || s == 0) {
+        mlog.logger()->error("No portfolio of {} assets fits weights [{}, {}] over {} scenarios", n,
+                             constraints.min_weight_, constraints.max_weight_, s);
+        return Allocation();
+    }
+    auto r = vector<double>(s * n), mean = vector<double>(n, 0.0);
+    for (auto i = size_t(0); i < s * n; ++i) r[i] = expm1(returns.r_[i]);
+    for (auto i = size_t(0); i < s; ++i) {
+        for (auto a = size_t(0); a < n; ++a) mean[a] += r[i * n + a] / s;
+    }
+    /* Projected subgradient on CVaR(w) - return_weight m'w. For fixed weights the Rockafellar-Uryasev threshold is
+    the VaR, so the subgradient is minus the mean return over the tail scenarios */
+    const auto tail   = max<size_t>(1, static_cast<size_t>((1.0 - confidence) * s + 1e-9));
+    auto       w      = vector<double>(), best = vector<double>(), g = vector<double>(n), next = vector<double>();
+    auto       losses = vector<double>(s);
+    auto       order  = vector<size_t>(s);
+    auto       best_objective = numeric_limits<double>::max(), best_cvar = 0.0;
+    project(vector<double>(n, 1.0 / n), constraints, w);
+    const auto chunk = size_t(1024);
+    for (auto it = 0; it < 2000; ++it) {
+        concurrency::parallel_for(size_t(0), (s + chunk - 1) / chunk, [&](const size_t c) {
+            for (auto i = c * chunk; i < min(s, (c + 1) * chunk); ++i) losses[i] = -dot(r.data() + i * n, w.data(), n);
+        });
+        iota(begin(order), end(order), size_t(0));
+        nth_element(begin(order), begin(order) + (tail - 1), end(order),
+                    [&losses](const size_t a, const size_t b) { return losses[a] > losses[b]; });
+        auto cvar = 0.0;
+        fill(begin(g), end(g), 0.0);
+        for (auto k = size_t(0); k < tail; ++k) {
+            cvar += losses[order[k]] / tail;
+            for (auto a = size_t(0); a < n; ++a) g[a] -= r[order[k] * n + a] / tail;
+        }
+        const auto objective = cvar - return_weight * dot(mean.data(), w.data(), n);
+        if (objective < best_objective) {
+            best_objective = objective;
+            best_cvar      = cvar;
+            best           = w;
+        }
+        auto norm = 0.0;
+        for (auto a = size_t(0); a < n; ++a) {
+            g[a] -= return_weight * mean[a];
+            norm += g[a] * g[a];
+        }
+        if (norm == 0.0) break;
+        // Diminishing steps, the first moves the weights by up to a half
+        const auto step = 0.5 / (sqrt(norm) * sqrt(it + 1.0));
+        for (auto a = size_t(0); a < n; ++a) g[a] = w[a] - step * g[a];
+        project(g, constraints, next);
+        w.swap(next);
+    }
+    return Allocation{best, dot(mean.data(), best.data(), n), best_cvar};
+}
+
+auto AARC::Optimiser::frontier(const Estimates &estimates, const std::vector<double> &risk_aversions,
+                               const Constraints &constraints) -> std::vector<Allocation> {
+    auto out = std::vector<Allocation>(risk_aversions.size());
+    concurrency::parallel_for(size_t(0), risk_aversions.size(), [&](const size_t i) {
+        out[i] = mean_variance(estimates, risk_aversions[i], constraints);
+    });
+    return out;
+}
+
+auto AARC::Optimiser::cvar_frontier(const VaR::Returns &returns, const double confidence,
+                                    const std::vector<double> &return_weights, const Constraints &constraints)
+    -> std::vector<Allocation> {
+    auto out = std::vector<Allocation>(return_weights.size());
+    concurrency::parallel_for(size_t(0), return_weights.size(), [&](const size_t i) {
+        out[i] = min_cvar(returns, confidence, return_weights[i], constraints);
+    });
+    return out;
+}
+
+namespace {
+    // Normal log returns with the given vols, correlation rho between every pair and drifts
+    auto simulated(const std::vector<double> &vols, const std::vector<double> &drifts, const double rho,
+                   const size_t days) -> AARC::VaR::Returns {
+        const auto n   = vols.size();
+        auto       out = AARC::VaR::Returns();
+        auto       z   = std::vector<double>(days * (n + 1));
+        auto       s   = AARC::Random::Stream{11};
+        AARC::Random::normal(s, z.data(), z.size());
+        for (auto a = size_t(0); a < n; ++a) out.assets_.emplace_back(a);
+        for (auto d = size_t(0); d < days; ++d) {
+            out.ts_.emplace_back(d);
+            for (auto a = size_t(0); a < n; ++a) {
+                const auto e = std::sqrt(rho) * z[d * (n + 1)] + std::sqrt(1.0 - rho) * z[d * (n + 1) + 1 + a];
+                out.r_.emplace_back(drifts[a] + vols[a] * e);
+            }
+        }
+        return out;
+    }
+} // namespace
+
+TEST_CASE("Optimiser mean variance") {
+    using namespace AARC::Optimiser;
+    // Two assets, the minimum variance mix is known
+    const auto s1 = 0.2, s2 = 0.1, rho = 0.3;
+    const auto two = Estimates{{0.0, 0.0}, {s1 * s1, rho * s1 * s2, rho * s1 * s2, s2 * s2}};
+    const auto mv  = mean_variance(two, 1.0);
+    const auto w1  = (s2 * s2 - rho * s1 * s2) / (s1 * s1 + s2 * s2 - 2 * rho * s1 * s2);
+    REQUIRE(mv.weights_.size() == 2);
+    CHECK(mv.weights_[0] == doctest::Approx(w1).epsilon(1e-8));
+    CHECK(mv.weights_[1] == doctest::Approx(1 - w1).epsilon(1e-8));
+
+    const auto r   = simulated({0.01, 0.015, 0.02, 0.025}, {0.0002, 0.0004, 0.0006, 0.0008}, 0.3, 5000);
+    const auto est = estimate(r);
+    CHECK(est.cov_[1] == est.cov_[4]);
+    CHECK(est.cov_[5] == doctest::Approx(0.015 * 0.015).epsilon(0.05));
+    // Less risk aversion buys more return with more risk, always fully invested and inside the limits
+    const auto limits = Constraints{0.0, 0.6};
+    const auto f      = frontier(est, {1000.0, 100.0, 30.0, 10.0, 0.01}, limits);
+    for (auto i = size_t(0); i < f.size(); ++i) {
+        CHECK(std::accumulate(begin(f[i].weights_), end(f[i].weights_), 0.0) == doctest::Approx(1.0));
+        for (const auto x : f[i].weights_) CHECK((x >= -1e-12 && x <= 0.6 + 1e-12));
+        if (i > 0) {
+            CHECK(f[i].return_ >= f[i - 1].return_ - 1e-12);
+            CHECK(f[i].risk_ >= f[i - 1].risk_ - 1e-12);
+        }
+    }
+    // Almost risk neutral, as much as allowed in the best estimated returns
+    CHECK(*std::max_element(begin(f.back().weights_), end(f.back().weights_)) == doctest::Approx(0.6));
+    // Shorting allowed can only lower the minimum variance
+    CHECK(mean_variance(est, 1e4, Constraints{-0.5, 1.0}).risk_ <= f.front().risk_);
+    CHECK(mean_variance(est, 1.0, Constraints{0.0, 0.1}).weights_.empty());
+}
+
+TEST_CASE("Optimiser minimum CVaR") {
+    using namespace AARC::Optimiser;
+    // Normal returns without drift, so minimum CVaR is minimum variance
+    const auto r  = simulated({0.01, 0.02, 0.03}, {0.0, 0.0, 0.0}, 0.2, 20000);
+    const auto mv = mean_variance(estimate(r), 1e4);
+    const auto cv = min_cvar(r, 0.95);
+    REQUIRE(cv.weights_.size() == 3);
+    for (auto a = size_t(0); a < 3; ++a) CHECK(std::abs(cv.weights_[a] - mv.weights_[a]) < 0.05);
+    CHECK(cv.risk_ == doctest::Approx(2.063 * mv.risk_).epsilon(0.05));
+    // Rewarding return moves towards the drifting asset
+    const auto drift = simulated({0.01, 0.02, 0.03}, {0.0, 0.0, 0.002}, 0.2, 5000);
+    const auto f     = cvar_frontier(drift, 0.95, {0.0, 10.0});
+    CHECK(f[1].weights_[2] > f[0].weights_[2]);
+    CHECK(f[1].return_ > f[0].return_);
+}
+
+TEST_CASE("Optimiser benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::Optimiser;
+    using namespace std::chrono;
+    auto vols = std::vector<double>(), drifts = std::vector<double>();
+    for (auto a = 0; a < 200; ++a) {
+        vols.emplace_back(0.01 + 0.0001 * a);
+        drifts.emplace_back(0.00001 * (a % 17));
+    }
+    const auto r     = simulated(vols, drifts, 0.3, 1000);
+    auto       start = high_resolution_clock::now();
+    const auto est   = estimate(r);
+    const auto cov   = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    auto       gammas = std::vector<double>();
+    for (auto i = 0; i < 20; ++i) gammas.emplace_back(std::pow(10.0, 4.0 - 0.2 * i));
+    start         = high_resolution_clock::now();
+    const auto f  = frontier(est, gammas, Constraints{0.0, 0.05});
+    const auto us = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    CHECK(f.size() == gammas.size());
+    spdlog::get("logger")->info("Optimiser 200 assets covariance {}us, 20 point frontier {}us", cov, us);
+}
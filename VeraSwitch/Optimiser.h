@@ -0,0 +1,44 @@
+#pragma once
+#include "VaR.h"
+#include <cstdint>
+#include <vector>
+
+namespace AARC {
+    namespace Optimiser {
+        /* Long/short limited, fully invested portfolios. Mean-variance maximises return less risk aversion / 2 times
+        variance, minimum CVaR minimises the expected loss in the worst 1 - confidence of the return scenarios less
+        return_weight times the mean return. Both are solved by projection onto the budget and weight limits, so
+        every iterate is a valid portfolio, and a frontier is a sweep of independent solves run in parallel */
+
+        // Per period mean returns and the covariance, cov_[i * assets + j]
+        struct Estimates {
+            std::vector<double> mean_;
+            std::vector<double> cov_;
+        };
+
+        struct Constraints {
+            double min_weight_ = 0.0; // Below 0 allows shorting
+            double max_weight_ = 1.0;
+        };
+
+        struct Allocation {
+            std::vector<double> weights_;
+            double              return_ = 0.0; // Expected per period
+            double              risk_   = 0.0; // Standard deviation, or CVaR as a fraction of capital
+        };
+
+        auto estimate(const VaR::Returns &returns) -> Estimates;
+
+        auto mean_variance(const Estimates &estimates, const double risk_aversion,
+                           const Constraints &constraints = Constraints()) -> Allocation;
+        auto min_cvar(const VaR::Returns &returns, const double confidence, const double return_weight = 0.0,
+                      const Constraints &constraints = Constraints()) -> Allocation;
+
+        // One allocation per risk aversion (or return weight), in the same order
+        auto frontier(const Estimates &estimates, const std::vector<double> &risk_aversions,
+                      const Constraints &constraints = Constraints()) -> std::vector<Allocation>;
+        auto cvar_frontier(const VaR::Returns &returns, const double confidence,
+                           const std::vector<double> &return_weights, const Constraints &constraints = Constraints())
+            -> std::vector<Allocation>;
+    } // namespace Optimiser
+} // namespace AARC
@@ -0,0 +1,297 @@
+#include "Pde.h"
+#include "BlackScholes.h"
+#include "Split.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <map>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+#include <tuple>
+
+namespace {
+    using namespace AARC::Pde;
+
+    /* What is actually solved on a grid, a vanilla or knock-out. Knock-ins are the vanilla less the knock-out, so an
+     * option can be more than one leg */
+    struct Leg {
+        size_t  option_  = 0;
+        double  sign_    = 1.0;
+        bool    call_    = true;
+        double  strike_  = 100.0;
+        Barrier barrier_ = Barrier::NONE;
+    };
+
+    // Thomas factorisation of the implicit side for the interior nodes, same for every option on the grid
+    struct Factored {
+        double              lower_ = 0.0;
+        double              upper_ = 0.0;
+        std::vector<double> factor_;
+        std::vector<double> pivot_;
+    };
+
+    auto factorise(const double a, const double b, const double c, const double h, const size_t interior)
+        -> Factored {
+        auto       out  = Factored{-h * a, -h * c, std::vector<double>(interior), std::vector<double>(interior)};
+        const auto diag = 1.0 - h * b;
+        for (auto i = size_t(0); i < interior; ++i) {
+            out.pivot_[i]  = 1.0 / (i == 0 ? diag : diag - out.lower_ * out.factor_[i - 1]);
+            out.factor_[i] = out.upper_ * out.pivot_[i];
+        }
+        return out;
+    }
+
+    // Value and log spot derivatives at x from the three nodes nearest it
+    auto at(const double *values, const size_t count, const size_t k, const double lower, const double dx,
+            const size_t steps, const double x) -> std::tuple<double, double, double> {
+        using namespace std;
+        const auto pos = (x - lower) / dx;
+        const auto j   = static_cast<size_t>(min(max(llround(pos), 1LL), static_cast<long long>(steps) - 1));
+        const auto e   = x - (lower + j * dx);
+        const auto vm = values[(j - 1) * count + k], v = values[j * count + k], vp = values[(j + 1) * count + k];
+        const auto vx  = (vp - vm) / (2.0 * dx);
+        const auto vxx = (vp - 2.0 * v + vm) / (dx * dx);
+        return make_tuple(v + vx * e + 0.5 * vxx * e * e, vx + vxx * e, vxx);
+    }
+
+    // Solves every leg on one grid, expiry and barrier are shared
+    auto solve(const Model &model, const Settings &settings, const double expiry, const Barrier barrier,
+               const double level, const std::vector<Leg> &legs, Arena &arena) -> std::vector<Result> {
+        using namespace std;
+        const auto count = legs.size();
+        const auto steps = max<size_t>(settings.space_steps_, 4), times = max<size_t>(settings.time_steps_, 1);
+        const auto nodes = steps + 1, interior = steps - 1;
+        const auto x0    = log(model.spot_);
+        const auto span  = settings.width_ * model.vol_ * sqrt(expiry);
+        const auto lower = barrier == Barrier::DOWN_AND_OUT ? log(level) : x0 - span;
+        const auto upper = barrier == Barrier::UP_AND_OUT ? log(level) : x0 + span;
+        const auto dx    = (upper - lower) / steps;
+        const auto h     = expiry / times;
+        const auto r = model.rate_, q = model.dividend_, var = model.vol_ * model.vol_;
+        const auto nu = r - q - 0.5 * var;
+        // V_tau = a V[i-1] + b V[i] + c V[i+1]
+        const auto a = 0.5 * var / (dx * dx) - 0.5 * nu / dx;
+        const auto b = -var / (dx * dx) - r;
+        const auto c = 0.5 * var / (dx * dx) + 0.5 * nu / dx;
+        // Crank-Nicolson over h and fully implicit over h / 2 have the same implicit side
+        const auto factored = factorise(a, b, c, 0.5 * h, interior);
+
+        auto  buffer   = acquire(arena, 2 * nodes * count + 2 * count);
+        auto *values   = buffer.data();
+        auto *scratch  = values + nodes * count;
+        auto *lower_bc = scratch + nodes * count;
+        auto *upper_bc = lower_bc + count;
+        for (auto i = size_t(0); i < nodes; ++i) {
+            const auto s = exp(lower + i * dx);
+            for (auto k = size_t(0); k < count; ++k) {
+                values[i * count + k] = max((legs[k].call_ ? 1.0 : -1.0) * (s - legs[k].strike_), 0.0);
+            }
+        }
+        const auto s_lo = exp(lower), s_hi = exp(upper);
+        const auto boundaries = [&](const double tau) {
+            for (auto k = size_t(0); k < count; ++k) {
+                const auto &leg     = legs[k];
+                const auto  forward = exp(-q * tau), strike = leg.strike_ * exp(-r * tau);
+                lower_bc[k] = leg.barrier_ == Barrier::DOWN_AND_OUT || leg.call_ ? 0.0 : strike - s_lo * forward;
+                upper_bc[k] = leg.barrier_ == Barrier::UP_AND_OUT || !leg.call_ ? 0.0 : s_hi * forward - strike;
+            }
+        };
+        boundaries(0.0);
+        for (auto k = size_t(0); k < count; ++k) {
+            values[k]                       = lower_bc[k];
+            values[(nodes - 1) * count + k] = upper_bc[k];
+        }
+        // Explicit side weight w, 0 for an implicit half step and h / 2 for Crank-Nicolson
+        const auto step = [&](const double w) {
+            ispc::pde_step(values, scratch, nodes, count, w * a, 1.0 + w * b, w * c, factored.lower_,
+                           factored.upper_, factored.factor_.data(), factored.pivot_.data(), lower_bc, upper_bc);
+        };
+
+        auto out = vector<Result>(count);
+        for (auto n = size_t(0); n < times; ++n) {
+            // Value a step before expiry, for theta
+            if (n == times - 1) {
+                for (auto k = size_t(0); k < count; ++k) {
+                    out[k].theta_ = get<0>(at(values, count, k, lower, dx, steps, x0));
+                }
+            }
+            if (n < settings.rannacher_steps_) {
+                boundaries((n + 0.5) * h);
+                step(0.0);
+                boundaries((n + 1.0) * h);
+                step(0.0);
+            } else {
+                boundaries((n + 1.0) * h);
+                step(0.5 * h);
+            }
+        }
+        const auto spot = model.spot_;
+        for (auto k = size_t(0); k < count; ++k) {
+            const auto v  = at(values, count, k, lower, dx, steps, x0);
+            out[k].theta_ = (out[k].theta_ - get<0>(v)) / h;
+            out[k].price_ = get<0>(v);
+            out[k].delta_ = get<1>(v) / spot;
+            out[k].gamma_ = (get<2>(v) - get<1>(v)) / (spot * spot);
+        }
+        release(arena, move(buffer));
+        return out;
+    }
+} // namespace
+
+auto AARC::Pde::acquire(Arena &arena, const size_t count) -> std::vector<double> {
+    std::lock_guard<std::mutex> lock(arena.mutex_);
+    const auto it = std::find_if(begin(arena.free_), end(arena.free_),
+                                 [count](const std::vector<double> &b) { return b.capacity() >= count; });
+    if (it == end(arena.free_)) return std::vector<double>(count);
+    auto out = std::move(*it);
+    arena.free_.erase(it);
+    out.resize(count);
+    return out;
+}
+
+auto AARC::Pde::release(Arena &arena, std::vector<double> &&buffer) -> void {
+    std::lock_guard<std::mutex> lock(arena.mutex_);
+    arena.free_.emplace_back(std::move(buffer));
+}
+
+auto AARC::Pde::price(const Model &model, const Option &option, const Settings &settings) -> Result {
+    return price(model, std::vector<Option>{option}, settings).front();
+}
+
+auto AARC::Pde::price(const Model &model, const std::vector<Option> &options, const Settings &settings)
+    -> std::vector<Result> {
+    Arena arena;
+    return price(model, options, settings, arena);
+}
+
+auto AARC::Pde::price(const Model &model, const std::vector<Option> &options, const Settings &settings,
+                      Arena &arena) -> std::vector<Result> {
+    using namespace std;
+    MethodLogger mlog("Pde::price");
+    auto         out = vector<Result>(options.size());
+    if (model.vol_ <= 0.0 || model.spot_ <= 0.0) {
+        mlog.logger()->error("Needs positive spot and vol, have {} and {}", model.spot_, model.vol_);
+        return out;
+    }
+    // Legs grouped by the grid they need, (expiry, barrier, level)
+    auto grids = map<tuple<double, Barrier, double>, vector<Leg>>();
+    for (auto i = size_t(0); i < options.size(); ++i) {
+        const auto &o       = options[i];
+        const auto  up      = o.barrier_type_ == Barrier::UP_AND_OUT || o.barrier_type_ == Barrier::UP_AND_IN;
+        const auto  in      = o.barrier_type_ == Barrier::UP_AND_IN || o.barrier_type_ == Barrier::DOWN_AND_IN;
+        const auto  out_    = up ? Barrier::UP_AND_OUT : Barrier::DOWN_AND_OUT;
+        const auto  knocked = up ? model.spot_ >= o.barrier_ : model.spot_ <= o.barrier_;
+        if (o.expiry_ <= 0.0) {
+            const auto alive = o.barrier_type_ == Barrier::NONE || knocked == in;
+            out[i].price_    = alive ? max((o.call_ ? 1.0 : -1.0) * (model.spot_ - o.strike_), 0.0) : 0.0;
+            continue;
+        }
+        if (o.barrier_type_ == Barrier::NONE || (in && knocked)) {
+            grids[make_tuple(o.expiry_, Barrier::NONE, 0.0)].emplace_back(Leg{i, 1.0, o.call_, o.strike_});
+        } else if (!knocked) {
+            if (in) grids[make_tuple(o.expiry_, Barrier::NONE, 0.0)].emplace_back(Leg{i, 1.0, o.call_, o.strike_});
+            grids[make_tuple(o.expiry_, out_, o.barrier_)].emplace_back(
+                Leg{i, in ? -1.0 : 1.0, o.call_, o.strike_, out_});
+        }
+    }
+    // Flattened before the solves, the map isn't safe to look up from several threads
+    auto keys      = vector<tuple<double, Barrier, double>>();
+    auto grid_legs = vector<vector<Leg>>();
+    for (auto &g : grids) {
+        keys.emplace_back(g.first);
+        grid_legs.emplace_back(move(g.second));
+    }
+    auto results = vector<vector<Result>>(keys.size());
+    concurrency::parallel_for(size_t(0), keys.size(), [&](const size_t g) {
+        results[g] = solve(model, settings, get<0>(keys[g]), get<1>(keys[g]), get<2>(keys[g]), grid_legs[g], arena);
+    });
+    for (auto g = size_t(0); g < keys.size(); ++g) {
+        const auto &legs = grid_legs[g];
+        for (auto k = size_t(0); k < legs.size(); ++k) {
+            auto &      o = out[legs[k].option_];
+            const auto &r = results[g][k];
+            const auto  s = legs[k].sign_;
+            o.price_ += s * r.price_;
+            o.delta_ += s * r.delta_;
+            o.gamma_ += s * r.gamma_;
+            o.theta_ += s * r.theta_;
+        }
+    }
+    return out;
+}
+
+TEST_CASE("PDE against Black-Scholes") {
+    using namespace AARC::Pde;
+    const auto model   = Model{100.0, 0.05, 0.02, 0.25};
+    auto       options = std::vector<Option>();
+    for (const auto call : {true, false}) {
+        for (const auto strike : {70.0, 90.0, 100.0, 110.0, 140.0}) {
+            for (const auto expiry : {0.25, 1.0}) options.emplace_back(Option{call, strike, expiry});
+        }
+    }
+    const auto results = price(model, options);
+    REQUIRE(results.size() == options.size());
+    for (auto i = size_t(0); i < options.size(); ++i) {
+        const auto &o   = options[i];
+        const auto  bs  = [&](const double ds, const double dt) {
+            return AARC::BlackScholes::value(100.0 + ds, o.strike_, 0.25, 0.05, 0.02, o.expiry_ + dt, o.call_);
+        };
+        const auto h = 0.01;
+        CHECK(results[i].price_ == doctest::Approx(bs(0, 0)).epsilon(1e-3).scale(1.0));
+        CHECK(results[i].delta_ == doctest::Approx((bs(h, 0) - bs(-h, 0)) / (2 * h)).epsilon(1e-3).scale(1.0));
+        CHECK(results[i].gamma_ ==
+              doctest::Approx((bs(h, 0) - 2 * bs(0, 0) + bs(-h, 0)) / (h * h)).epsilon(1e-3).scale(1.0));
+        CHECK(results[i].theta_ == doctest::Approx(-(bs(0, 1e-4) - bs(0, -1e-4)) / 2e-4).epsilon(1e-2).scale(1.0));
+    }
+    // Solved together or one at a time is the same
+    CHECK(price(model, options[3]).price_ == doctest::Approx(results[3].price_).epsilon(1e-12));
+}
+
+TEST_CASE("PDE barriers") {
+    using namespace AARC::Pde;
+    using namespace std;
+    const auto s = 100.0, k = 100.0, b = 90.0, r = 0.05, q = 0.02, v = 0.25, t = 1.0;
+    // Down and in call with the barrier under the strike (Reiner and Rubinstein)
+    const auto n      = [](const double x) { return 0.5 * erfc(-x / sqrt(2.0)); };
+    const auto lambda = (r - q + 0.5 * v * v) / (v * v);
+    const auto y      = log(b * b / (s * k)) / (v * sqrt(t)) + lambda * v * sqrt(t);
+    const auto in     = s * exp(-q * t) * pow(b / s, 2 * lambda) * n(y) -
+                    k * exp(-r * t) * pow(b / s, 2 * lambda - 2) * n(y - v * sqrt(t));
+    const auto vanilla = AARC::BlackScholes::value(s, k, v, r, q, t, true);
+
+    const auto model   = Model{s, r, q, v};
+    const auto options = vector<Option>{{true, k, t, Barrier::DOWN_AND_IN, b},
+                                        {true, k, t, Barrier::DOWN_AND_OUT, b},
+                                        {true, k, t, Barrier::DOWN_AND_OUT, 101.0},
+                                        {true, k, t, Barrier::DOWN_AND_IN, 101.0},
+                                        {false, k, t, Barrier::UP_AND_OUT, 120.0},
+                                        {false, k, t}};
+    const auto results = price(model, options, Settings{800, 400});
+    CHECK(results[0].price_ == doctest::Approx(in).epsilon(2e-3));
+    CHECK(results[1].price_ == doctest::Approx(vanilla - in).epsilon(2e-3));
+    // Already through the barrier
+    CHECK(results[2].price_ == 0.0);
+    CHECK(results[3].price_ == doctest::Approx(vanilla).epsilon(1e-3));
+    // A knock-out is worth less than the vanilla, and more as the barrier moves away
+    CHECK(results[4].price_ > 0.0);
+    CHECK(results[4].price_ < results[5].price_);
+    CHECK(price(model, Option{false, k, t, Barrier::UP_AND_OUT, 150.0}).price_ > results[4].price_);
+    // Just above the barrier a down and out call is pinned towards 0, so it moves faster than spot
+    CHECK(price(model, Option{true, k, t, Barrier::DOWN_AND_OUT, 99.0}).delta_ > 1.0);
+}
+
+TEST_CASE("PDE benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::Pde;
+    using namespace std::chrono;
+    auto options = std::vector<Option>();
+    for (auto i = 0; i < 1000; ++i) options.emplace_back(Option{i % 2 == 0, 50.0 + i % 100, 0.25 * (1 + i % 8)});
+    Arena      arena;
+    auto       results = price(Model{100.0, 0.03, 0.01, 0.3}, options, Settings(), arena);
+    const auto start   = high_resolution_clock::now();
+    results            = price(Model{100.5, 0.03, 0.01, 0.3}, options, Settings(), arena);
+    const auto us      = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    CHECK(results.size() == options.size());
+    spdlog::get("logger")->info("PDE 1000 options on 8 grids {}us", us);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace AARC {
+    namespace Pde {
+        /* Crank-Nicolson finite difference pricer for vanilla and barrier options under Black-Scholes, on a uniform
+        grid in log spot. Options sharing an expiry and barrier share a grid, so the tridiagonal system is factored
+        once and each time step is solved for all of their strikes together, vectorised across the options.
+        Barriers are continuously monitored and sit on the edge of the grid. The first steps are fully implicit
+        (Rannacher) so the payoff kink doesn't leave oscillations in the Greeks */
+
+        enum class Barrier { NONE, UP_AND_OUT, DOWN_AND_OUT, UP_AND_IN, DOWN_AND_IN };
+
+        struct Option {
+            bool    call_         = true;
+            double  strike_       = 100.0;
+            double  expiry_       = 1.0; // Years
+            Barrier barrier_type_ = Barrier::NONE;
+            double  barrier_      = 0.0;
+        };
+
+        struct Model {
+            double spot_     = 100.0;
+            double rate_     = 0.0;
+            double dividend_ = 0.0;
+            double vol_      = 0.2;
+        };
+
+        struct Settings {
+            size_t space_steps_     = 400;
+            size_t time_steps_      = 200;
+            double width_           = 5.0; // Standard deviations of log spot either side of spot without a barrier
+            size_t rannacher_steps_ = 2;   // Leading steps done as two implicit half steps each
+        };
+
+        // Greeks straight off the grid, theta per year
+        struct Result {
+            double price_ = 0.0;
+            double delta_ = 0.0;
+            double gamma_ = 0.0;
+            double theta_ = 0.0;
+        };
+
+        /* Grid workspaces handed back for reuse, so repricing (e.g. every frame while inputs move) doesn't allocate
+         * once the arena has seen the biggest grid. Safe to share between threads */
+        struct Arena {
+            std::mutex                       mutex_;
+            std::vector<std::vector<double>> free_;
+        };
+
+        // A buffer of at least count doubles, reused from the arena if one is free
+        auto acquire(Arena &arena, const size_t count) -> std::vector<double>;
+        auto release(Arena &arena, std::vector<double> &&buffer) -> void;
+
+        auto price(const Model &model, const Option &option, const Settings &settings = Settings()) -> Result;
+
+        // Results in the same order as the options, grids are solved in parallel
+        auto price(const Model &model, const std::vector<Option> &options, const Settings &settings = Settings())
+            -> std::vector<Result>;
+        auto price(const Model &model, const std::vector<Option> &options, const Settings &settings, Arena &arena)
+            -> std::vector<Result>;
+    } // namespace Pde
+} // namespace AARC
@@ -0,0 +1,69 @@
+#pragma once
+#include "AssetFactory.h"
+#include <cstdint>
+#include <vector>
+
+namespace AARC {
+    namespace Portfolio {
+        /* Book of positions in assets and options on them, revalued under a grid of spot, vol and time shocks. Every
+        position's value in every scenario is kept, so when a spot, vol or quantity changes only the positions it
+        touches are repriced and the P&L surface is moved by the difference. Dragging a slider on one asset then
+        costs that asset's options, not the whole book */
+
+        enum class Instrument : int8_t { UNDERLYING, CALL, PUT };
+
+        // Positions in SoA layout, asset_ indexes the book's market data
+        struct Positions {
+            std::vector<size_t>     asset_;
+            std::vector<double>     quantity_;
+            std::vector<Instrument> instrument_;
+            std::vector<float>      strike_;
+            std::vector<float>      expiry_; // Years
+        };
+
+        // Spot shocks are relative (-0.1 is spot down 10%), vol shocks absolute and time shocks in calendar days
+        struct Shocks {
+            std::vector<float> spot_ = {0.0f};
+            std::vector<float> vol_  = {0.0f};
+            std::vector<float> days_ = {0.0f};
+        };
+
+        struct Book {
+            std::vector<Asset> assets_;
+            std::vector<float> spot_; // Per asset
+            std::vector<float> vol_;  // Per asset
+            float              rate_ = 0.0f;
+            Positions          positions_;
+            Shocks             shocks_;
+
+            // values_[p * scenarios + s] is position p in scenario s, value_[p] is its unshocked value
+            std::vector<float> values_;
+            std::vector<float> value_;
+            // P&L against today, pnl_[(d * vols + v) * spots + s] for days d, vol shock v and spot shock s
+            std::vector<double> pnl_;
+            std::vector<uint8_t> dirty_;
+        };
+
+        // Adds the asset to the book if it isn't there, returns its index
+        auto add(Book &book, const Asset &asset, const float spot, const float vol) -> size_t;
+
+        // Position in the asset itself or an option on it, returns the position's index
+        auto add(Book &book, const size_t asset, const double quantity) -> size_t;
+        auto add(Book &book, const size_t asset, const double quantity, const bool call, const float strike,
+                 const float expiry) -> size_t;
+        auto remove(Book &book, const size_t position) -> void;
+
+        // Changing an input marks the positions that depend on it for repricing
+        auto set_spot(Book &book, const size_t asset, const float spot) -> void;
+        auto set_vol(Book &book, const size_t asset, const float vol) -> void;
+        auto set_rate(Book &book, const float rate) -> void;
+        auto set_quantity(Book &book, const size_t position, const double quantity) -> void;
+        auto set_shocks(Book &book, const Shocks &shocks) -> void;
+
+        // Reprices the marked positions under every scenario and updates pnl_, returns how many were repriced
+        auto revalue(Book &book) -> size_t;
+
+        // Book value today
+        auto value(const Book &book) -> double;
+    } // namespace Portfolio
+} // namespace AARC
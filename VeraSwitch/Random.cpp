@@ -0,0 +1,191 @@
+#include "Random.h"
+#include "Split.h"
+#include <algorithm>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <limits>
+#include <numeric>
+#include <ppl.h>
+
+namespace {
+    using namespace AARC::Random;
+
+    // Blocks handed to one parallel task, the split doesn't change the numbers only who calculates them
+    constexpr size_t chunk_blocks = 4096;
+
+    template <typename T, typename Kernel>
+    auto fill(Stream &s, T *out, const size_t count, const size_t per_block, Kernel kernel) -> void {
+        const auto key0    = static_cast<uint32_t>(s.seed_), key1 = static_cast<uint32_t>(s.seed_ >> 32);
+        const auto stream0 = static_cast<uint32_t>(s.stream_), stream1 = static_cast<uint32_t>(s.stream_ >> 32);
+        const auto whole   = count / per_block;
+        const auto first   = s.position_;
+        concurrency::parallel_for(size_t(0), (whole + chunk_blocks - 1) / chunk_blocks, [&](const size_t c) {
+            const auto blocks = std::min(chunk_blocks, whole - c * chunk_blocks);
+            kernel(key0, key1, stream0, stream1, first + c * chunk_blocks, blocks,
+                   out + c * chunk_blocks * per_block);
+        });
+        // Part of a block left over
+        if (count > whole * per_block) {
+            T tail[4];
+            kernel(key0, key1, stream0, stream1, first + whole, 1, tail);
+            std::copy(tail, tail + count - whole * per_block, out + whole * per_block);
+        }
+        s.position_ += (count + per_block - 1) / per_block;
+    }
+} // namespace
+
+auto AARC::Random::philox(const std::array<uint32_t, 4> &counter, const std::array<uint32_t, 2> &key)
+    -> std::array<uint32_t, 4> {
+    auto c = counter;
+    auto k = key;
+    for (auto round = 0; round < 10; ++round) {
+        const auto p0 = uint64_t(0xD2511F53) * c[0];
+        const auto p1 = uint64_t(0xCD9E8D57) * c[2];
+        c             = {{static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k[0], static_cast<uint32_t>(p1),
+              static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k[1], static_cast<uint32_t>(p0)}};
+        k[0] += 0x9E3779B9;
+        k[1] += 0xBB67AE85;
+    }
+    return c;
+}
+
+auto AARC::Random::uniform(Stream &s, float *out, const size_t count) -> void {
+    fill(s, out, count, 4, ispc::philox_float);
+}
+
+auto AARC::Random::uniform(Stream &s, double *out, const size_t count) -> void {
+    fill(s, out, count, 2, ispc::philox_double);
+}
+
+auto AARC::Random::normal(Stream &s, float *out, const size_t count) -> void {
+    uniform(s, out, count);
+    ispc::inverse_normal_float(out, count);
+}
+
+auto AARC::Random::normal(Stream &s, double *out, const size_t count) -> void {
+    uniform(s, out, count);
+    ispc::inverse_normal_double(out, count);
+}
+
+auto AARC::Random::inverse_normal(const double p) -> double {
+    using namespace std;
+    if (p <= 0.0) return -numeric_limits<double>::infinity();
+    if (p >= 1.0) return numeric_limits<double>::infinity();
+    static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                               1.383577518672690e+02,  -3.066479806614716e+01, 2.506628277459239e+00};
+    static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                               6.680131188771972e+01, -1.328068155211027e+01};
+    static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                               -2.549732539343734e+00, 4.374664141464968e+00,  2.938163982698783e+00};
+    static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                               3.754408661907416e+00};
+    const auto p_low = 0.02425;
+    auto       x     = 0.0;
+    if (p < p_low || p > 1.0 - p_low) {
+        const auto q = sqrt(-2.0 * log(p < p_low ? p : 1.0 - p));
+        x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+        if (p > 0.5) x = -x;
+    } else {
+        const auto q = p - 0.5, r = q * q;
+        x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+            (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+    }
+    // Halley refinement against the exact CDF
+    const auto e = 0.5 * erfc(-x / sqrt(2.0)) - p;
+    const auto u = e * sqrt(2.0 * 3.14159265358979323846) * exp(x * x / 2.0);
+    return x - u / (1.0 + x * u / 2.0);
+}
+
+auto AARC::Random::uniform_int(const int a, const int b, const uint64_t seed, const size_t count) -> std::vector<int> {
+    using namespace std;
+    const auto lo = min(a, b), hi = max(a, b);
+    auto       u  = vector<double>(count);
+    auto       s  = Stream{seed};
+    uniform(s, u.data(), count);
+    auto out = vector<int>(count);
+    transform(begin(u), end(u), begin(out), [lo, hi](const double v) {
+        return min(hi, lo + static_cast<int>(floor(v * (static_cast<double>(hi) - lo + 1.0))));
+    });
+    return out;
+}
+
+auto AARC::Random::walk(const size_t count, const uint64_t seed, const Walk &shape) -> TSData {
+    using namespace std;
+    // A second normal per bar only when there are wicks
+    const auto draws = shape.wick_ > 0.0 ? size_t(2) : size_t(1);
+    auto       z     = vector<double>(draws * count);
+    auto       s     = Stream{seed};
+    normal(s, z.data(), z.size());
+    auto out   = TSData();
+    auto price = 100.0;
+    for (auto i = size_t(0); i < count; ++i) {
+        const auto open = price;
+        price *= exp((i < shape.turn_ ? shape.drift_ : -shape.drift_) + shape.vol_ * z[draws * i]);
+        const auto wick = draws > 1 ? shape.wick_ * price * abs(z[draws * i + 1]) : 0.0;
+        out.ts_.emplace_back(i);
+        out.open_.emplace_back(float(open));
+        out.high_.emplace_back(float(max(open, price) + wick));
+        out.low_.emplace_back(float(min(open, price) - wick));
+        out.close_.emplace_back(float(price));
+    }
+    return out;
+}
+
+TEST_CASE("Philox known answers") {
+    using namespace AARC::Random;
+    using W = std::array<uint32_t, 4>;
+    CHECK(philox({{0, 0, 0, 0}}, {{0, 0}}) == W{{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}});
+    CHECK(philox({{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}}, {{0xffffffff, 0xffffffff}}) ==
+          W{{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}});
+    CHECK(philox({{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}}, {{0xa4093822, 0x299f31d0}}) ==
+          W{{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}});
+
+    // The vectorised generator is the same function of (seed, stream, block)
+    auto s   = Stream{0x299f31d0a4093822ULL, 0x0370734413198a2eULL, 0x85a308d3243f6a88ULL};
+    auto out = std::vector<float>(4);
+    uniform(s, out.data(), out.size());
+    CHECK(out[0] == ((0xd16cfe09u >> 9) + 0.5f) / 8388608.0f);
+    CHECK(out[3] == ((0x24126ea1u >> 9) + 0.5f) / 8388608.0f);
+}
+
+TEST_CASE("Random streams") {
+    using namespace AARC::Random;
+    // Same numbers whether drawn in one go or a piece at a time, as long as pieces are whole blocks
+    auto one   = Stream{42, 7};
+    auto whole = std::vector<double>(100002);
+    normal(one, whole.data(), whole.size());
+    auto pieces = Stream{42, 7};
+    auto part   = std::vector<double>(50000);
+    normal(pieces, part.data(), part.size());
+    CHECK(std::equal(begin(part), end(part), begin(whole)));
+    normal(pieces, part.data(), part.size());
+    CHECK(std::equal(begin(part), end(part), begin(whole) + 50000));
+    CHECK(one.position_ == 50001);
+
+    // Different streams don't overlap
+    auto other = Stream{42, 8};
+    auto x     = std::vector<double>(1000);
+    normal(other, x.data(), x.size());
+    CHECK(!std::equal(begin(x), end(x), begin(whole)));
+
+    // Moments of the normals
+    const auto mean = std::accumulate(begin(whole), end(whole), 0.0) / whole.size();
+    auto       var  = 0.0;
+    for (const auto v : whole) var += (v - mean) * (v - mean);
+    var /= whole.size();
+    CHECK(std::abs(mean) < 0.01);
+    CHECK(var == doctest::Approx(1.0).epsilon(0.02));
+
+    auto f = std::vector<float>(100001);
+    auto s = Stream{1};
+    uniform(s, f.data(), f.size());
+    CHECK(std::all_of(begin(f), end(f), [](const float v) { return v > 0.0f && v < 1.0f; }));
+
+    CHECK(inverse_normal(0.975) == doctest::Approx(1.959963984540054).epsilon(1e-12));
+    CHECK(inverse_normal(1e-10) == doctest::Approx(-6.361340902404056).epsilon(1e-12));
+    const auto ints = uniform_int(6, 1, 3, 60000);
+    for (auto face = 1; face <= 6; ++face) {
+        CHECK(std::count(begin(ints), end(ints), face) == doctest::Approx(10000).epsilon(0.05));
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "TimeSeries.h"
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace AARC {
+    namespace Random {
+        /* Counter based random numbers (Philox4x32-10). Each number is a pure function of the seed, the stream and
+        its position in the stream, there is no state to share or advance between threads. Giving every path (or
+        block of paths) its own stream makes a simulation come out the same whatever the thread count and whichever
+        order the blocks finish in. A stream is 2^64 blocks of four 32 bit words long */
+        struct Stream {
+            uint64_t seed_     = 0;
+            uint64_t stream_   = 0;
+            uint64_t position_ = 0; // Next block of four words
+        };
+
+        // One Philox4x32-10 block, for checking against the published test vectors
+        auto philox(const std::array<uint32_t, 4> &counter, const std::array<uint32_t, 2> &key)
+            -> std::array<uint32_t, 4>;
+
+        /* Uniforms in (0, 1), never exactly 0 or 1 so they can go straight into an inverse CDF. Each call starts on
+         * a fresh block, a float uses one word and a double two */
+        auto uniform(Stream &s, float *out, const size_t count) -> void;
+        auto uniform(Stream &s, double *out, const size_t count) -> void;
+
+        // Standard normals by inverse CDF of the uniforms above
+        auto normal(Stream &s, float *out, const size_t count) -> void;
+        auto normal(Stream &s, double *out, const size_t count) -> void;
+
+        // Acklam's inverse normal CDF with one Halley step, close to double precision
+        auto inverse_normal(const double p) -> double;
+
+        // Integers uniformly distributed over [a, b]
+        auto uniform_int(const int a, const int b, const uint64_t seed, const size_t count) -> std::vector<int>;
+
+        // Shape of a geometric random walk of bars, log returns are drift_ + vol_ * z
+        struct Walk {
+            double vol_   = 0.01;
+            double wick_  = 0.0; // High and low wick_ * price * |z| outside the open and close
+            double drift_ = 0.0; // Changes sign from bar turn_ on
+            size_t turn_  = std::numeric_limits<size_t>::max();
+        };
+
+        // Bars for tests and examples, ts_ is the bar number and the first open is 100
+        auto walk(const size_t count, const uint64_t seed, const Walk &shape = Walk()) -> TSData;
+    } // namespace Random
+} // namespace AARC
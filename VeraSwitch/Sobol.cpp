@@ -1,204 +1,221 @@
-// Sobol.cpp : Defines the exported functions for the DLL application.
-//
-
 #include "Sobol.h"
-#include <ppl.h>
+#include "Split.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdio>
+#include <doctest\doctest.h>
+#include <fstream>
+#include <ppl.h>
+#include <sstream>
+#include <string>
 
-std::vector<int> uniform(const int a, const int b, const int seed, const int count) {
-	if (seed == 0) {
-		printf("Invalid seed, cant be 0");
-		return std::vector<int>();
-	}
+namespace {
+    using namespace AARC::Sobol;
 
-	int next_seed = seed % 214748367;
-	if (next_seed < 0) {
-		next_seed += 214748367;
-	}
+    // Primitive polynomial, its degree s is the top bit, and the first s odd initial values m_k < 2^k
+    struct Polynomial {
+        uint32_t                poly_;
+        std::array<uint32_t, 8> m_;
+    };
+    // Bratley and Fox (ACM TOMS 659), the first dimension is the van der Corput sequence
+    const Polynomial bratley_fox[] = {
+        {1, {{}}}, {3, {{1}}}, {7, {{1, 1}}}, {11, {{1, 3, 7}}}, {13, {{1, 1, 5}}}, {19, {{1, 3, 1, 1}}},
+        {25, {{1, 1, 3, 7}}}, {37, {{1, 3, 3, 9, 9}}}, {59, {{1, 3, 7, 13, 3}}}, {47, {{1, 1, 5, 11, 27}}},
+        {61, {{1, 3, 5, 1, 15}}}, {55, {{1, 1, 7, 3, 29}}}, {41, {{1, 3, 7, 7, 21}}}, {67, {{1, 1, 1, 9, 23, 37}}},
+        {97, {{1, 3, 3, 5, 19, 33}}}, {91, {{1, 1, 3, 13, 11, 7}}}, {109, {{1, 1, 7, 13, 25, 5}}},
+        {103, {{1, 3, 5, 11, 7, 11}}}, {115, {{1, 1, 1, 3, 13, 39}}}, {131, {{1, 3, 1, 15, 17, 63, 13}}},
+        {193, {{1, 1, 5, 5, 1, 27, 33}}}, {137, {{1, 3, 3, 3, 25, 17, 115}}}, {145, {{1, 1, 3, 15, 29, 15, 41}}},
+        {143, {{1, 3, 1, 7, 3, 23, 79}}}, {241, {{1, 3, 7, 9, 31, 29, 17}}}, {157, {{1, 1, 5, 13, 11, 3, 29}}},
+        {185, {{1, 3, 1, 9, 5, 21, 119}}}, {167, {{1, 1, 3, 1, 23, 13, 75}}}, {229, {{1, 3, 3, 11, 27, 31, 73}}},
+        {171, {{1, 1, 7, 7, 19, 25, 105}}}, {213, {{1, 3, 5, 5, 21, 9, 7}}}, {191, {{1, 1, 1, 15, 5, 49, 59}}},
+        {253, {{1, 1, 1, 1, 1, 33, 65}}}, {203, {{1, 3, 5, 15, 17, 19, 21}}}, {211, {{1, 1, 7, 11, 13, 29, 3}}},
+        {239, {{1, 3, 7, 5, 7, 11, 113}}}, {247, {{1, 1, 5, 3, 15, 19, 61}}}, {285, {{1, 3, 1, 1, 9, 27, 89, 7}}},
+        {369, {{1, 1, 3, 7, 31, 15, 45, 23}}}, {299, {{1, 3, 3, 9, 9, 25, 107, 39}}}};
 
+    auto degree(const uint32_t poly) -> uint32_t {
+        auto s = uint32_t(0);
+        while (poly >> (s + 1)) ++s;
+        return s;
+    }
 
-	// Store seeds
-	std::vector<int> seeds;
-	seeds.reserve(count);
-#pragma loop(ivdep)
-	for (int n = 0; n < count; ++n) {
-		next_seed = next_seed % 214748367;
-		if (next_seed < 0) {
-			next_seed += 214748367;
-		}
-		int k = next_seed / 127773;
-		next_seed = 16807 * (next_seed - k * 127773) - k * 2836;
-		if (next_seed < 0)
-			next_seed += 214748367;
-		seeds.emplace_back(next_seed);
-	}
+    /* Direction numbers of dimension d from the polynomial degree s, its interior coefficients a (the top and
+    constant terms are always set) and the initial values m, with the recurrence
+    v_k = v_k-s ^ (v_k-s >> s) ^ a_1 v_k-1 ^ ... ^ a_s-1 v_k-s+1 */
+    auto expand(const uint32_t s, const uint32_t a, const uint32_t *m, Directions &dirs, const size_t d) -> void {
+        auto v = std::array<uint32_t, bits>();
+        if (s == 0) {
+            for (auto k = size_t(0); k < bits; ++k) v[k] = 1u << (bits - 1 - k);
+        } else {
+            for (auto k = size_t(0); k < s && k < bits; ++k) v[k] = m[k] << (bits - 1 - k);
+            for (auto k = size_t(s); k < bits; ++k) {
+                v[k] = v[k - s] ^ (v[k - s] >> s);
+                for (auto i = uint32_t(1); i < s; ++i) {
+                    if ((a >> (s - 1 - i)) & 1) v[k] ^= v[k - i];
+                }
+            }
+        }
+        for (auto k = size_t(0); k < bits; ++k) dirs.v_[k * dirs.dims_ + d] = v[k];
+    }
 
+    auto empty_directions(const size_t dims) -> Directions {
+        return Directions{dims, std::vector<uint32_t>(dims * bits)};
+    }
+} // namespace
 
+auto AARC::Sobol::directions(const size_t dims) -> Directions {
+    MethodLogger mlog("Sobol::directions");
+    constexpr auto max_dims = sizeof(bratley_fox) / sizeof(bratley_fox[0]);
+    if (dims > max_dims) {
+        mlog.logger()->error("Only {} dimensions built in, {} asked for. Use load_joe_kuo", max_dims, dims);
+        return Directions();
+    }
+    auto dirs = empty_directions(dims);
+    for (auto d = size_t(0); d < dims; ++d) {
+        const auto &p = bratley_fox[d];
+        const auto  s = degree(p.poly_);
+        const auto  a = s > 1 ? (p.poly_ >> 1) & ((1u << (s - 1)) - 1) : 0u;
+        expand(s, a, p.m_.data(), dirs, d);
+    }
+    return dirs;
+}
 
-	concurrency::parallel_transform(std::begin(seeds),std::end(seeds),std::begin(seeds),[&a,&b](auto s){
-		float r = (float) s * (float)4.656612875E-10;
-		r = ((float)1.0 - r) * (min(a, b) - (float)0.5) + r *(max(a, b) + (float)0.5);
-		int value = (int)roundf(r);
-		value = max(value, min(a, b));
-		value = min(value, max(a, b));
-		return value;
-	});
-	return seeds;
+auto AARC::Sobol::load_joe_kuo(const std::string &filename, const size_t dims) -> Directions {
+    using namespace std;
+    MethodLogger mlog("Sobol::load_joe_kuo");
+    if (dims == 0) return Directions();
+    ifstream in(filename);
+    auto     line = string();
+    if (!getline(in, line)) {
+        mlog.logger()->error("Could not read direction numbers from {}", filename);
+        return Directions();
+    }
+    auto dirs = empty_directions(dims);
+    expand(0, 0, nullptr, dirs, 0);
+    auto m = vector<uint32_t>();
+    for (auto d = size_t(1); d < dims; ++d) {
+        auto fields = istringstream();
+        auto dim = uint32_t(0), s = uint32_t(0), a = uint32_t(0);
+        if (getline(in, line)) fields.str(line);
+        if (!(fields >> dim >> s >> a) || s >= bits) {
+            mlog.logger()->error("{} has {} dimensions, {} asked for", filename, d, dims);
+            return Directions();
+        }
+        m.resize(s);
+        for (auto &mk : m) fields >> mk;
+        if (!fields) {
+            mlog.logger()->error("{} is short of direction numbers for dimension {}: {}", filename, dim, line);
+            return Directions();
+        }
+        expand(s, a, m.data(), dirs, d);
+    }
+    return dirs;
 }
 
-int hibit(unsigned int n) {
-	int bit = 0;
-	while (n > 0) {
-		++bit;
-		n /= 2;
-	}
-	return bit;
+auto AARC::Sobol::generator(const Directions &dirs, const uint64_t index) -> Generator {
+    // Point n is the XOR of the direction numbers picked out by the bits of its Gray code n ^ (n >> 1)
+    auto       gen  = Generator{&dirs, index, std::vector<uint32_t>(dirs.dims_)};
+    const auto gray = index ^ (index >> 1);
+    for (auto k = size_t(0); k < bits; ++k) {
+        if (!((gray >> k) & 1)) continue;
+        for (auto d = size_t(0); d < dirs.dims_; ++d) gen.state_[d] ^= dirs.v_[k * dirs.dims_ + d];
+    }
+    return gen;
 }
 
-int lobit(unsigned int n) {
-	int bit = 1;
-	while (n != 2 * (n >> 1)) {
-		++bit;
-		n = n >> 1;
-	}
-	return bit;
+auto AARC::Sobol::next(Generator &gen, float *out, const size_t count) -> void {
+    MethodLogger mlog("Sobol::next");
+    if (gen.index_ + count >= (uint64_t(1) << bits)) {
+        mlog.logger()->error("Sobol sequence only has 2^{} points", bits);
+        return;
+    }
+    const auto &dirs = *gen.directions_;
+    ispc::sobol_block(dirs.v_.data(), gen.state_.data(), dirs.dims_, gen.index_, count, out);
+    gen.index_ += count;
 }
 
-boost::multi_array<int, 2> sobol(const int dim_num) {
-	constexpr int dim_max = 40;
-	constexpr int log_max = 30;
-	const int dim_num_save = dim_num;
-	multi_array<int, 2> v(extents[dim_max][log_max]);
-	typedef multi_array<int, 2>::index_range range;
-	std::fill(v.data(), v.data() + v.num_elements(), 0);
-	auto column = v[indices[range()][0]];
-	std::fill(column.begin(), column.end(), 1);
-	std::array<int, 38> v1 = { 1, 3, 1, 3, 1, 3, 3, 1,3, 1, 3, 1, 3, 1, 1, 3, 1, 3,1, 3, 1, 3, 3, 1, 3, 1, 3, 1,3, 1, 1, 3, 1, 3, 1, 3, 1, 3 };
-	std::copy(v1.begin(), v1.end(), v[indices[range().start(dim_max - v1.size())][1]].begin());
-	std::array<int, 37> v2 = { 7, 5, 1, 3, 3, 7, 5, 5, 7, 7, 1, 3, 3, 7, 5, 1, 1,5, 3, 3, 1, 7, 5, 1, 3, 3, 7,5, 1, 1, 5, 7, 7, 5, 1, 3, 3 };
-	std::copy(v2.begin(), v2.end(), v[indices[range().start(dim_max - v2.size())][2]].begin());
-	std::array<int, 35> v3 = { 1, 7,  9,  13, 11, 1, 3,  7,  9,  5,  13, 13, 11, 3, 15, 5, 3,  15, 7,  9,  13, 9,  1,  11, 7, 5, 15, 1,  15, 11, 5,  3,  1,  7,  9 };
-	std::copy(v3.begin(), v3.end(), v[indices[range().start(dim_max - v3.size())][3]].begin());
-	std::array<int, 33> v4 = { 9, 3, 27, 15, 29, 21, 23, 19, 11, 25, 7, 13, 17, 1, 25, 29, 3, 31, 11, 5, 23, 27, 19,21, 5, 1, 17, 13, 7, 15, 9, 31, 9 };
-	std::copy(v4.begin(), v4.end(), v[indices[range().start(dim_max - v4.size())][4]].begin());
-	std::array<int, 27> v5 = { 37, 33, 7,  5,  11, 39, 63,27, 17, 15, 23, 29, 3,  21, 13, 31, 25,9,  49, 33, 19, 29, 11, 19, 27, 15, 25 };
-	std::copy(v5.begin(), v5.end(), v[indices[range().start(dim_max - v5.size())][5]].begin());
-	std::array<int, 21> v6 = { 13, 33, 115, 41, 79, 17, 29,  119, 75, 73, 105, 7,  59,  65, 21, 3,  113, 61,  89, 45, 107 };
-	std::copy(v6.begin(), v6.end(), v[indices[range().start(dim_max - v6.size())][6]].begin());
-	std::array<int, 3> v7 = { 7, 23, 39 };
-	std::copy(v7.begin(), v7.end(), v[indices[range().start(dim_max - v7.size())][7]].begin());
-	std::array<int, 40> poly = { 1, 3, 7, 11, 13, 19, 25, 37, 59, 47,61, 55, 41, 67, 97, 91, 109, 103, 115, 131,193, 137, 145, 143, 241, 157, 185, 167, 229, 171, 213, 191, 253, 203, 211, 239, 247, 285, 369, 299 };
-	const unsigned int atmost = static_cast<unsigned int>(::pow(2, log_max) - 1);
-	// Number of bits in atmost
-	const int maxcol = hibit(atmost);
-	// Init row 1 of v to 1
-	auto row1 = v[indices[0][range(0, maxcol)]];
-	std::transform(row1.begin(), row1.end(), row1.begin(), [](auto&) { return 1; });
-	if (dim_num < 1 || dim_max < dim_num) {
-		return v;
-	}
-	// Initialise rest of v
-#pragma loop(ivdep)
-	for (auto i = 1; i < dim_num; i++) {
-		auto j = poly[i];
-		auto m = 0;
-		j = j >> 1;
-		while (j > 0) {
-			++m;
-			j = j >> 1;
-		}
-		j = poly[i];
-		// Expand this bit pattern to separate components of the logical array INCLUD
-		std::vector<int> includ(m, 0);
-#pragma loop(ivdep)
-		for (auto k = m - 1; k >= 0; --k) {
-			auto j2 = j / 1;
-			includ[k] = (j != (j2 * 2));
-			j = j2;
-		}
-#pragma loop(ivdep)
-		// Calculate the remaining elements of row I as explained in Bratley and Fox, section 2
-		for (auto j = m; j < maxcol; j++) {
-			auto newv = v[i][j - m];
-			auto l = 1;
-#pragma loop(ivdep)
-			for (auto k = 0; k < m; k++) {
-				l = l << 1;
-				if (includ[k]) {
-					newv = newv ^ (l * v[i][j - k - 1]);
-				}
-			}
-			v[i][j] = newv;
-		}
-	}
-	// Multiply columns of V by appropriate power of 2
-	auto l = 1U;
-	for (auto j = maxcol - 2; j >= 0; --j) {
-		l = l << 1;
-		auto col = v[indices[range(0, dim_num)][j]];
-		std::transform(col.begin(), col.end(), col.begin(), [&l](auto i) { return i * l; });
-	}
-	return v;
+auto AARC::Sobol::generate(const Directions &dirs, const size_t count, const uint64_t skip) -> std::vector<float> {
+    const auto chunk  = size_t(4096);
+    auto       points = std::vector<float>(count * dirs.dims_);
+    concurrency::parallel_for(size_t(0), (count + chunk - 1) / chunk, [&](const size_t c) {
+        auto gen = generator(dirs, skip + c * chunk);
+        next(gen, points.data() + c * chunk * dirs.dims_, std::min(chunk, count - c * chunk));
+    });
+    return points;
 }
 
-std::vector<int> create_dim(const int dim_num, const int seed, const multi_array<int, 2>& v) {
-	auto l = 0;
-	auto seed_save = seed - 2;
-	std::vector<int> lastq(dim_num,0);
+TEST_CASE("Sobol sequence") {
+    using namespace AARC::Sobol;
+    const auto dirs = directions(40);
+    REQUIRE(dirs.dims_ == 40);
+    CHECK(directions(41).v_.empty());
 
-	// Seed generation
-	int new_seed = seed;
-	if (new_seed < 0)
-		new_seed = 0;
-	if (new_seed == 0)
-		l = 1;
-	else if (new_seed == seed_save + 1) {
-		l = lobit(new_seed);
-	} else if (new_seed <= seed_save) {
-		seed_save = 0;
-		for (auto st = seed_save; st < new_seed; ++st) {
-			l = lobit(st);
-			for (auto i = 0; i < dim_num; ++i) {
-				lastq[i] = lastq[i] ^ v[i][l - 1];
-			}
-		}
-		l = lobit(new_seed);
-	} else if (seed_save + 1 < new_seed) {
-		for (auto st = seed_save + 1; st <= new_seed - 1; ++st) {
-			l = lobit(st);
-			for (auto i = 0; i < dim_num; ++i) {
-				lastq[i] = lastq[i] ^ v[i][l - 1];
-			}
-		}
-		l = lobit(new_seed);
-	}
-	return lastq;
+    // First two dimensions against the published sequence
+    const auto points = generate(dirs, 1 << 12);
+    const auto first  = std::vector<float>{0.0f, 0.5f, 0.75f, 0.25f, 0.375f, 0.875f, 0.625f, 0.125f};
+    const auto second = std::vector<float>{0.0f, 0.5f, 0.25f, 0.75f, 0.375f, 0.875f, 0.125f, 0.625f};
+    for (auto n = size_t(0); n < first.size(); ++n) {
+        CHECK(points[n * 40] == first[n]);
+        CHECK(points[n * 40 + 1] == second[n]);
+    }
+    // Every dimension of the first 2^k points has exactly one point in each 1/2^k interval
+    for (auto d = size_t(0); d < 40; ++d) {
+        auto buckets = std::vector<int>(1 << 12);
+        for (auto n = size_t(0); n < buckets.size(); ++n) buckets[static_cast<size_t>(points[n * 40 + d] * 4096)]++;
+        CHECK(std::all_of(begin(buckets), end(buckets), [](const int b) { return b == 1; }));
+    }
+    // Skipping ahead and generating in blocks gives the same points as one long run
+    const auto skipped = generate(dirs, 1000, 3001);
+    CHECK(std::equal(begin(skipped), end(skipped), begin(points) + 3001 * 40));
+    auto gen   = generator(dirs, 17);
+    auto block = std::vector<float>(5 * 40);
+    next(gen, block.data(), 5);
+    next(gen, block.data(), 5);
+    CHECK(gen.index_ == 27);
+    CHECK(std::equal(begin(block), end(block), begin(points) + 22 * 40));
 }
 
-// Sobol number generator
-// dim_num - number of dimensions
-// n - number of random numbers to produce
-// dimension - number of dimension to return (sobol sugggests first 10 or so are correlated so don't use)
-std::vector<float> sobol_gen(const int dim_num, const int n, const int dimension) {
-	constexpr int log_max = 30;
-	const unsigned int atmost = static_cast<unsigned int>(math::pow<log_max>(2) - 1);
-	// Number of bits in atmost
-	const int maxcol = hibit(atmost);
-	auto l = 1 << (maxcol);
-	// Common denominator of V
-	const auto recipd = (float)1.0 / (float)(l);
-	const int sz = dim_num * n;
-	auto v = sobol(dim_num);
-
-	// For each sub problem take the lastq, generate the quasi numbers
-	const auto lastq = create_dim(dim_num, 0, v);
-	const auto vrow = v[dimension];
-	auto nextseed = lastq[dimension];
-	std::vector<float> quasi;
-	for (int s = 0; s < n;s++) {
-		const auto l = lobit(s);
-		quasi.emplace_back(nextseed * recipd);
-		nextseed = int(nextseed) ^ int(vrow[l - 1]);
-	}
-	return quasi;
+TEST_CASE("Sobol Joe-Kuo direction numbers") {
+    using namespace AARC::Sobol;
+    // A temporary file, removed however the test ends
+    struct TempFile {
+        const std::string name_ = std::tmpnam(nullptr);
+        ~TempFile() { std::remove(name_.c_str()); }
+    };
+    TempFile    file;
+    const auto &filename = file.name_;
+    {
+        auto out = std::ofstream(filename);
+        out << "d       s       a       m_i\n"
+               "2       1       0       1\n"
+               "3       2       1       1 3\n"
+               "4       3       1       1 3 1\n"
+               "5       3       2       1 1 1\n"
+               "6       4       1       1 1 3 3\n"
+               "7       4       4       1 3 5 13\n";
+    }
+    const auto dirs = load_joe_kuo(filename, 7);
+    CHECK(load_joe_kuo(filename, 8).v_.empty());
+    {
+        // Dimension 6 is cut off after its second direction number
+        auto out = std::ofstream(filename);
+        out << "d       s       a       m_i\n"
+               "2       1       0       1\n"
+               "3       2       1       1 3\n"
+               "4       3       1       1 3 1\n"
+               "5       3       2       1 1 1\n"
+               "6       4       1       1 1\n";
+    }
+    CHECK(load_joe_kuo(filename, 5).dims_ == 5);
+    CHECK(load_joe_kuo(filename, 6).v_.empty());
+    REQUIRE(dirs.dims_ == 7);
+    const auto points = generate(dirs, 1 << 10);
+    const auto third  = std::vector<float>{0.0f, 0.5f, 0.25f, 0.75f, 0.625f};
+    for (auto n = size_t(0); n < third.size(); ++n) CHECK(points[n * 7 + 2] == third[n]);
+    for (auto d = size_t(0); d < 7; ++d) {
+        auto buckets = std::vector<int>(1 << 10);
+        for (auto n = size_t(0); n < buckets.size(); ++n) buckets[static_cast<size_t>(points[n * 7 + d] * 1024)]++;
+        CHECK(std::all_of(begin(buckets), end(buckets), [](const int b) { return b == 1; }));
+    }
 }
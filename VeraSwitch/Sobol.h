@@ -1,6 +1,43 @@
 #pragma once
-
+#include <cstdint>
+#include <string>
 #include <vector>
 
-__declspec(dllexport) std::vector<int> uniform(const int a, const int b, const int seed, const int count);
-__declspec(dllexport) std::vector<float> sobol_gen(const int dim_num, const int n, const int skip);
+namespace AARC {
+    namespace Sobol {
+        /* Sobol low discrepancy sequence. Direction numbers are built once per dimension count and shared, each
+        Generator then walks the sequence in Gray code order so the next point is the last one XOR a single direction
+        number per dimension. Any point can be reached directly so threads can each take a disjoint range of the
+        sequence and between them produce exactly what one generator would have.
+        Points are indexed from 0, which is the origin in every dimension */
+        constexpr size_t bits = 32;
+
+        // v_[k * dims_ + d] is direction number k of dimension d, bit-major so a point's update is contiguous
+        struct Directions {
+            size_t                dims_ = 0;
+            std::vector<uint32_t> v_;
+        };
+
+        // Bratley and Fox primitive polynomials and initial values, up to 40 dimensions
+        auto directions(const size_t dims) -> Directions;
+
+        /* Joe and Kuo's direction numbers ("d s a m_i" with a header line, as in new-joe-kuo-6.21201) for up to
+         * several thousand dimensions. The first dimension isn't in the file. Empty if the file has fewer than dims */
+        auto load_joe_kuo(const std::string &filename, const size_t dims) -> Directions;
+
+        struct Generator {
+            const Directions *    directions_ = nullptr;
+            uint64_t              index_      = 0;
+            std::vector<uint32_t> state_;
+        };
+
+        // Generator positioned at point index
+        auto generator(const Directions &dirs, const uint64_t index = 0) -> Generator;
+
+        // Writes the next count points as a count x dims row-major block in [0, 1) and moves the generator on
+        auto next(Generator &gen, float *out, const size_t count) -> void;
+
+        // Points [skip, skip + count) as a count x dims block, ranges of the sequence are generated in parallel
+        auto generate(const Directions &dirs, const size_t count, const uint64_t skip = 0) -> std::vector<float>;
+    } // namespace Sobol
+} // namespace AARC
@@ -34,16 +34,37 @@ namespace ispc { /* namespace */
 #if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )
 extern "C" {
 #endif // __cplusplus
+    extern void backtest_bars(const float * open, const float * high, const float * low, const float * close, const int8_t * signal, const int64_t bars, const int64_t count, const double * rules, double * state, float * equity);
+    extern void bayes_scores(const float * values, const int64_t count, const int64_t features, const float * lo, const float * inv_width, const int32_t * bins, const int32_t * first, const float * log_prob, const int64_t total_bins, const float * log_prior, const int64_t classes, float * out);
+    extern void binomial_step(double * values, double * spots, const int64_t nodes, const double p_down, const double p_up, const double up, const double strike, const int8_t call, const bool exercise);
+    extern void black_scholes(const float * spot, const float * strike, const float * vol, const float * rate, const float * dividend, const float * expiry, const int8_t * call, float * price, float * delta, float * gamma, float * vega, float * theta, float * rho, const int64_t count);
+    extern void brownian_bridge(const double * normals, double * z, const int64_t count, const int64_t steps, const int64_t * bridge_index, const int64_t * left_index, const int64_t * right_index, const double * left_weight, const double * right_weight, const double * stddev, const double * sqrt_dt);
     extern void ema(const float * vin, float * vout, const int64_t count, const float period);
     extern void find_char(const uint8_t * arr, const int64_t start, const int64_t end, const int8_t delim, int32_t &pos);
-    extern void macd_sub(const float * vin, float * vout, const int64_t count, const float period, const float period2);
+    extern void forest_predict(const float * x, const int64_t count, const int64_t stride, const int32_t * feature, const float * threshold, const int32_t * child, const float * value, const int32_t * root, const int32_t * depth, const int64_t trees, const float base, float * out);
+    extern void implied_vol(const double * price, const double * spot, const double * strike, const double * rate, const double * dividend, const double * expiry, const int8_t * call, double * vol, const int64_t count);
+    extern void inverse_normal_double(double * vinout, const int64_t count);
+    extern void inverse_normal_float(float * vinout, const int64_t count);
+    extern void local_vol_paths(const double * z, double * paths, const int64_t count, const int64_t steps, const double spot, const double carry, const double dt, const double * vols, const double * spot_nodes, const int64_t nodes);
+    extern void macd(const float * vin, float * line, float * signal, float * hist, const int64_t count, const int64_t fast_period, const int64_t slow_period, const int64_t signal_period);
     extern int32_t naive_atoi(const uint8_t * buf, const int32_t sz);
+    extern void path_payoffs(const double * paths, double * out, const int64_t count, const int64_t steps, const double strike, const bool call, const int32_t kind, const double discount);
+    extern void pde_step(double * values, double * scratch, const int64_t nodes, const int64_t count, const double explicit_lower, const double explicit_diag, const double explicit_upper, const double implicit_lower, const double implicit_upper, const double * factor, const double * pivot, const double * lower_bc, const double * upper_bc);
     extern void period_return(const float * vin, const float * vin2, float * vout, const int64_t min_idx, const int64_t max_idx, const int64_t look_ahead_period);
+    extern void philox_double(const uint32_t key0, const uint32_t key1, const uint32_t stream0, const uint32_t stream1, const uint64_t first, const int64_t blocks, double * out);
+    extern void philox_float(const uint32_t key0, const uint32_t key1, const uint32_t stream0, const uint32_t stream1, const uint64_t first, const int64_t blocks, float * out);
+    extern void rank_one_update(double * c, const double * x, const int64_t n, const double scale);
+    extern void rolling_comoments(const float * x, const float * y, float * cov, float * corr, const int64_t count, const int64_t period);
+    extern void rolling_extrema(const float * vin, float * vout, const int64_t count, const int64_t period, const bool maximum);
+    extern void rolling_moments(const float * vin, float * mean, float * stddev, float * zscore, const int64_t count, const int64_t period);
     extern void rs_sum(const float * vin, float * vout, const int64_t count, const int64_t period, const bool up);
     extern void rsi(const float * rs_up, const float * rs_down, float * vout, const int64_t count);
     extern void rsi_summary(float * vinout, const int64_t count);
     extern void scale(const float * vin, float * vout, const int64_t count, const float scaling);
-    extern void smooth_outliers(const float * vin, float * vout, const int64_t count, const float tolerance, const float avg);
+    extern void sobol_block(const uint32_t * directions, uint32_t * state, const int64_t dims, const int64_t first, const int64_t count, float * out);
+    extern void stoch_k(const float * close, const float * highest, const float * lowest, float * vout, const int64_t count);
+    extern void syrk_tile(const double * x, const double * weight, double * c, const int64_t rows, const int64_t n, const int64_t i0, const int64_t i1, const int64_t j0, const int64_t j1);
+    extern void trinomial_step(double * values, double * spots, const int64_t nodes, const double p_down, const double p_mid, const double p_up, const double strike, const int8_t call, const bool exercise);
 #if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )
 } /* end extern C */
 #endif // __cplusplus
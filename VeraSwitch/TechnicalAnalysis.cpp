@@ -1,6 +1,7 @@
 #include "TechnicalAnalysis.h"
 #include "Split.h"
 #include "TimeSeries.h"
+#include <array>
 #include <deque>
 #include <doctest\doctest.h>
 #include <future>
@@ -71,42 +72,56 @@ auto AARC::TA::resample(const AARC::TSData &in, const int mins) -> AARC::TSData
     return TSData(in.asset_, ts.get(), open.get(), high.get(), low.get(), close.get());
 }
 
-auto AARC::TA::smooth_outliers(const TSData &in, const float tolerance) -> const TSData {
-    using namespace std;
-    if (in.ts_.empty() || tolerance == 0.0f) return in;
-    const auto &pos = rand() % (in.ts_.size() - 10) + 10;
-    const auto &avg = [ sum = 0.0f, &in, &pos ]() mutable {
-        if ((pos + 10) > in.close_.size()) return 0.0f;
-        for (auto i = pos; i < pos + 10; i++) { sum += (in.close_[i] - in.close_[i - 1]); }
-        return sum / 10.0f;
+namespace {
+    // Median of [first, last), reorders the range
+    auto median(float *first, float *last) -> float {
+        const auto mid = first + (last - first) / 2;
+        std::nth_element(first, mid, last);
+        if ((last - first) % 2) return *mid;
+        return (*mid + *std::max_element(first, mid)) * 0.5f;
     }
-    ();
-    if (avg == 0.0f) return in;
-    auto &&open = async(launch::async, [&in, &tolerance, &avg]() {
-        const auto &sz   = in.open_.size();
-        const auto  vout = make_unique<float[]>(sz);
-        ispc::smooth_outliers(in.open_.data(), vout.get(), sz, tolerance, avg);
-        return vector<float>(vout.get(), &vout.get()[sz]);
-    });
+} // namespace
 
-    auto &&high = async(launch::async, [&in, &tolerance, &avg]() {
-        const auto &&vout = make_unique<float[]>(in.high_.size());
-        ispc::smooth_outliers(in.high_.data(), vout.get(), in.high_.size(), tolerance, avg);
-        return vector<float>(vout.get(), &vout.get()[in.high_.size()]);
-    });
-
-    auto &&low = async(launch::async, [&in, &tolerance, &avg]() {
-        const auto vout = make_unique<float[]>(in.high_.size());
-        ispc::smooth_outliers(in.low_.data(), vout.get(), in.low_.size(), tolerance, avg);
-        return vector<float>(vout.get(), &vout.get()[in.low_.size()]);
-    });
+auto AARC::TA::smooth_outliers(const TSData &in, const float tolerance, const size_t window, const float n_sigmas)
+    -> const TSData {
+    using namespace std;
+    if (in.ts_.size() < window || window < 3) return in;
+    // MAD to standard deviation for normally distributed moves
+    constexpr auto mad_scale = 1.4826f;
+    const auto     sz        = in.ts_.size();
+    auto           out       = in;
+    const auto     columns   = array<const vector<float> *, 4>{{&in.open_, &in.high_, &in.low_, &in.close_}};
+    auto           smoothed  = array<vector<float> *, 4>{{&out.open_, &out.high_, &out.low_, &out.close_}};
 
-    auto &&close = async(launch::async, [&in, &tolerance, &avg]() {
-        const auto vout = make_unique<float[]>(in.close_.size());
-        ispc::smooth_outliers(in.close_.data(), vout.get(), in.close_.size(), tolerance, avg);
-        return vector<float>(vout.get(), &vout.get()[in.close_.size()]);
+    // Every bar only looks at the unfiltered input so chunks are independent, all four columns are done together
+    // while the window is in cache
+    const auto chunk = size_t(4096);
+    concurrency::parallel_for(size_t(0), (sz + chunk - 1) / chunk, [&](const size_t c) {
+        auto       values     = vector<float>(window);
+        auto       deviations = vector<float>(window);
+        const auto hi         = min(sz, (c + 1) * chunk);
+        for (auto i = max(c * chunk, window - 1); i < hi; ++i) {
+            auto replaced = false;
+            for (auto col = size_t(0); col < columns.size(); ++col) {
+                const auto &x = *columns[col];
+                copy(begin(x) + i + 1 - window, begin(x) + i + 1, begin(values));
+                const auto med = median(values.data(), values.data() + window);
+                transform(begin(x) + i + 1 - window, begin(x) + i + 1, begin(deviations),
+                          [med](const float v) { return abs(v - med); });
+                const auto mad = mad_scale * median(deviations.data(), deviations.data() + window);
+                // Flat windows have no MAD, the tolerance stops every tick out of them counting as an outlier
+                if (abs(x[i] - med) > max(n_sigmas * mad, tolerance * abs(med))) {
+                    (*smoothed[col])[i] = med;
+                    replaced            = true;
+                }
+            }
+            if (replaced) {
+                out.high_[i] = max({out.high_[i], out.open_[i], out.close_[i]});
+                out.low_[i]  = min({out.low_[i], out.open_[i], out.close_[i]});
+            }
+        }
     });
-    return TSData(in.asset_, in.ts_, open.get(), high.get(), low.get(), close.get());
+    return out;
 }
 
 auto AARC::TA::period_returns(const TSData &in, const size_t look_ahead_period, const PeriodReturnType pr_type,
@@ -169,36 +184,51 @@ auto AARC::TA::rsi(const std::vector<float> &in, const size_t period) -> std::ve
     ispc::rs_sum(in.data(), rs_up.get(), in.size(), period, true);
     auto rs_down = make_unique<float[]>(sz);
     ispc::rs_sum(in.data(), rs_down.get(), in.size(), period, false);
-    auto ema_up   = make_unique<float[]>(sz - period - 1);
-    auto ema_down = make_unique<float[]>(sz - period - 1);
+    if (sz < period) return vector<float>();
+    // The averaged sums start once there are period of them, bar 2 * period - 1
+    const auto &out_sz   = sz - period + 1;
+    auto        ema_up   = make_unique<float[]>(out_sz);
+    auto        ema_down = make_unique<float[]>(out_sz);
     ispc::ema(rs_up.get(), static_cast<float *>(ema_up.get()), sz, period);
     ispc::ema(rs_down.get(), static_cast<float *>(ema_down.get()), sz, period);
 
-    auto rsi_array = make_unique<float[]>(sz - period - 1);
-    ispc::rsi(ema_up.get(), ema_down.get(), rsi_array.get(), sz - period - 1);
-    return vector<float>(rsi_array.get(), &rsi_array.get()[sz - period - 1]);
+    auto rsi_array = make_unique<float[]>(out_sz);
+    ispc::rsi(ema_up.get(), ema_down.get(), rsi_array.get(), out_sz);
+    return vector<float>(rsi_array.get(), &rsi_array.get()[out_sz]);
 }
 
+namespace {
+    auto extrema(const std::vector<float> &in, const size_t period, const bool maximum) -> std::vector<float> {
+        if (period == 0 || in.size() < period) return std::vector<float>();
+        auto out = std::vector<float>(in.size() - period + 1);
+        ispc::rolling_extrema(in.data(), out.data(), in.size(), period, maximum);
+        return out;
+    }
+
+    // Sum is kept in double so long series don't drift
+    auto rolling_mean(const std::vector<float> &in, const size_t period) -> std::vector<float> {
+        if (period == 0 || in.size() < period) return std::vector<float>();
+        auto out = std::vector<float>(in.size() - period + 1);
+        auto sum = std::accumulate(begin(in), begin(in) + period, 0.0);
+        out[0]   = static_cast<float>(sum / period);
+        for (auto i = period; i < in.size(); ++i) {
+            sum += in[i] - in[i - period];
+            out[i - period + 1] = static_cast<float>(sum / period);
+        }
+        return out;
+    }
+} // namespace
+
 auto AARC::TA::ema(const std::vector<float> &in, const size_t period) -> std::vector<float> {
     if (in.empty() || period == 0) return std::vector<float>();
-    if (in.size() <= period) return in;
-    auto ema_ = vector<float>(in.size() - 1);
-    ispc::ema(in.data(), const_cast<float *>(ema_.data()), in.size(), static_cast<float>(period));
+    if (in.size() < period) return std::vector<float>();
+    auto ema_ = vector<float>(in.size() - period + 1);
+    ispc::ema(in.data(), ema_.data(), in.size(), static_cast<float>(period));
     return ema_;
 }
 
 auto AARC::TA::sma(const std::vector<float> &in, const size_t period) -> std::vector<float> {
-    using namespace std;
-    const auto &p_sum = [&in]() {
-        std::vector<float> sum;
-        std::partial_sum(begin(in), end(in), begin(sum));
-        return sum;
-    }();
-    auto sma = vector<float>();
-    for (auto i = size_t(0); i < in.size() - period; ++i) {
-        sma.emplace_back((in[i] - p_sum[i + period]) / static_cast<float>(period));
-    }
-    return sma;
+    return rolling_mean(in, period);
 }
 
 auto AARC::TA::wma(const std::vector<float> &in, const size_t period) -> std::vector<float> {
@@ -207,14 +237,117 @@ auto AARC::TA::wma(const std::vector<float> &in, const size_t period) -> std::ve
 }
 
 auto AARC::TA::macd(const std::vector<float> &in, const size_t upper_period, const size_t lower_period,
-                    const size_t crossover_period) -> std::vector<float> {
-    if (in.empty() || crossover_period == 0) return std::vector<float>();
-    if (in.size() <= crossover_period) return in;
-    auto ema_ = vector<float>(in.size() - 1);
-    ispc::macd_sub(in.data(), const_cast<float *>(ema_.data()), in.size(), static_cast<float>(lower_period),
-                   static_cast<float>(upper_period));
-    const auto crossover_ema = ema(ema_, crossover_period);
-    return crossover_ema;
+                    const size_t crossover_period) -> MACD {
+    using namespace std;
+    const auto slow = max(upper_period, lower_period), fast = min(upper_period, lower_period);
+    if (in.empty() || fast == 0 || crossover_period == 0) return MACD();
+    if (in.size() < slow + crossover_period - 1) return MACD();
+    const auto line_sz   = in.size() - slow + 1;
+    const auto signal_sz = line_sz - crossover_period + 1;
+    auto       out       = MACD{vector<float>(line_sz), vector<float>(signal_sz), vector<float>(signal_sz)};
+    ispc::macd(in.data(), out.line_.data(), out.signal_.data(), out.histogram_.data(), in.size(), fast, slow,
+               crossover_period);
+    return out;
+}
+
+auto AARC::TA::rolling_max(const std::vector<float> &in, const size_t period) -> std::vector<float> {
+    return extrema(in, period, true);
+}
+
+auto AARC::TA::rolling_min(const std::vector<float> &in, const size_t period) -> std::vector<float> {
+    return extrema(in, period, false);
+}
+
+auto AARC::TA::stoch(const TSData &in, const size_t k_period, const size_t d_period, const size_t k_slowing)
+    -> Stoch {
+    using namespace std;
+    if (k_period == 0 || d_period == 0 || k_slowing == 0) return Stoch();
+    if (in.close_.size() < k_period + k_slowing + d_period - 2) return Stoch();
+    // Highest high and lowest low are independent so run them together
+    auto       lowest  = async(launch::async, [&in, &k_period]() { return extrema(in.low_, k_period, false); });
+    const auto highest = extrema(in.high_, k_period, true);
+    const auto low     = lowest.get();
+    auto       fast_k  = vector<float>(highest.size());
+    ispc::stoch_k(in.close_.data() + k_period - 1, highest.data(), low.data(), fast_k.data(), fast_k.size());
+    auto k = k_slowing > 1 ? rolling_mean(fast_k, k_slowing) : move(fast_k);
+    auto d = rolling_mean(k, d_period);
+    return Stoch{move(k), move(d)};
+}
+
+auto AARC::TA::donchian(const TSData &in, const size_t period) -> Donchian {
+    using namespace std;
+    auto lower = async(launch::async, [&in, &period]() { return extrema(in.low_, period, false); });
+    auto out   = Donchian{extrema(in.high_, period, true), lower.get(), vector<float>()};
+    out.middle_.reserve(out.upper_.size());
+    transform(begin(out.upper_), end(out.upper_), begin(out.lower_), back_inserter(out.middle_),
+              [](const float u, const float l) { return (u + l) * 0.5f; });
+    return out;
+}
+
+auto AARC::TA::breakout(const TSData &in, const size_t period) -> std::vector<int> {
+    using namespace std;
+    const auto channel = donchian(in, period);
+    if (channel.upper_.size() < 2) return vector<int>();
+    // Compare each close against the channel up to the bar before it
+    auto out = vector<int>(channel.upper_.size() - 1);
+    for (auto i = size_t(0); i < out.size(); ++i) {
+        const auto close = in.close_[period + i];
+        out[i]           = close > channel.upper_[i] ? 1 : (close < channel.lower_[i] ? -1 : 0);
+    }
+    return out;
+}
+
+auto AARC::TA::rolling_stats(const std::vector<float> &in, const size_t period) -> RollingStats {
+    using namespace std;
+    if (period == 0 || in.size() < period) return RollingStats();
+    const auto sz  = in.size() - period + 1;
+    auto       out = RollingStats{vector<float>(sz), vector<float>(sz), vector<float>(sz)};
+    ispc::rolling_moments(in.data(), out.mean_.data(), out.stddev_.data(), out.zscore_.data(), in.size(), period);
+    return out;
+}
+
+auto AARC::TA::rolling_stats(const std::vector<float> &in, const std::vector<size_t> &periods)
+    -> std::vector<RollingStats> {
+    auto out = std::vector<RollingStats>(periods.size());
+    concurrency::parallel_for(size_t(0), periods.size(),
+                              [&](const size_t i) { out[i] = rolling_stats(in, periods[i]); });
+    return out;
+}
+
+auto AARC::TA::rolling_correlation(const std::vector<float> &a, const std::vector<float> &b, const size_t period)
+    -> RollingCorrelation {
+    using namespace std;
+    if (period == 0 || a.size() != b.size() || a.size() < period) return RollingCorrelation();
+    const auto sz  = a.size() - period + 1;
+    auto       out = RollingCorrelation{vector<float>(sz), vector<float>(sz)};
+    ispc::rolling_comoments(a.data(), b.data(), out.cov_.data(), out.corr_.data(), a.size(), period);
+    return out;
+}
+
+auto AARC::TA::bollinger(const std::vector<float> &in, const size_t period, const float width) -> Bollinger {
+    using namespace std;
+    auto stats = rolling_stats(in, period);
+    auto out   = Bollinger{vector<float>(), move(stats.mean_), vector<float>()};
+    out.upper_.reserve(out.middle_.size());
+    out.lower_.reserve(out.middle_.size());
+    for (auto i = size_t(0); i < out.middle_.size(); ++i) {
+        out.upper_.emplace_back(out.middle_[i] + width * stats.stddev_[i]);
+        out.lower_.emplace_back(out.middle_[i] - width * stats.stddev_[i]);
+    }
+    return out;
+}
+
+auto AARC::TA::rolling_volatility(const std::vector<float> &in, const size_t period, const float bars_per_year)
+    -> std::vector<float> {
+    using namespace std;
+    if (period < 2 || in.size() <= period) return vector<float>();
+    auto log_returns = vector<float>(in.size() - 1);
+    for (auto i = size_t(1); i < in.size(); ++i) log_returns[i - 1] = log(in[i] / in[i - 1]);
+    auto vol = rolling_stats(log_returns, period).stddev_;
+    // Population to sample deviation, then annualise
+    const auto scaling = static_cast<float>(sqrt(bars_per_year * period / (period - 1.0)));
+    for (auto &v : vol) v *= scaling;
+    return vol;
 }
 
 auto AARC::TA::scale(const std::vector<float> &in, const float a, const float b) noexcept -> std::vector<float> {
@@ -286,10 +419,229 @@ TEST_CASE("Technical analysis") {
     const auto rsi = AARC::TA::rsi(input.close_, 10);
     CHECK(!rsi.empty());
     const auto macd = AARC::TA::macd(input.close_, 26, 12, 9);
-    CHECK(!macd.empty());
+    CHECK(!macd.line_.empty());
     const auto scale = AARC::TA::scale(input.close_);
     CHECK(!scale.empty());
     const auto sma = AARC::TA::sma(input.close_, 10);
     CHECK(!sma.empty());
 
 }
+
+namespace {
+    // One bar at a time EMA of v from bar first, out[i] is bar i
+    auto reference_ema(const std::vector<float> &v, const size_t first, const size_t period) {
+        const auto alpha = 2.0f / (period + 1.0f);
+        auto       out   = std::vector<float>(v.size(), 0.0f);
+        auto       prev  = 0.0f;
+        for (auto i = first; i < first + period; ++i) prev += v[i];
+        prev /= period;
+        out[first + period - 1] = prev;
+        for (auto i = first + period; i < v.size(); ++i) out[i] = prev += alpha * (v[i] - prev);
+        return out;
+    }
+
+    // Straightforward one bar at a time MACD to check the vectorised one against
+    auto reference_macd(const std::vector<float> &in, const size_t fast, const size_t slow, const size_t signal) {
+        const auto ema = reference_ema;
+        const auto f = ema(in, 0, fast), s = ema(in, 0, slow);
+        auto       line = std::vector<float>(in.size(), 0.0f);
+        for (auto i = slow - 1; i < in.size(); ++i) line[i] = f[i] - s[i];
+        const auto sig = ema(line, slow - 1, signal);
+        auto       out = AARC::TA::MACD();
+        for (auto i = slow - 1; i < in.size(); ++i) out.line_.emplace_back(line[i]);
+        for (auto i = slow + signal - 2; i < in.size(); ++i) {
+            out.signal_.emplace_back(sig[i]);
+            out.histogram_.emplace_back(line[i] - sig[i]);
+        }
+        return out;
+    }
+
+    auto random_walk(const size_t sz) {
+        auto out = std::vector<float>(sz);
+        auto v   = 100.0f;
+        std::generate(begin(out), end(out), [&v, i = 0]() mutable { return v += std::sin(i++ * 0.37f) * 0.5f; });
+        return out;
+    }
+} // namespace
+
+TEST_CASE("MACD matches scalar reference") {
+    // Lengths that don't split evenly across the gang and ones shorter than a lane each
+    for (const auto sz : {34, 35, 36, 37, 100, 1001, 65537}) {
+        const auto in  = random_walk(sz);
+        const auto out = AARC::TA::macd(in, 26, 12, 9);
+        const auto ref = reference_macd(in, 12, 26, 9);
+        REQUIRE(out.line_.size() == ref.line_.size());
+        REQUIRE(out.signal_.size() == ref.signal_.size());
+        REQUIRE(out.histogram_.size() == ref.histogram_.size());
+        for (auto i = size_t(0); i < ref.line_.size(); ++i)
+            CHECK(out.line_[i] == doctest::Approx(ref.line_[i]).epsilon(0.001));
+        for (auto i = size_t(0); i < ref.signal_.size(); ++i) {
+            CHECK(out.signal_[i] == doctest::Approx(ref.signal_[i]).epsilon(0.001));
+            CHECK(out.histogram_[i] == doctest::Approx(ref.histogram_[i]).epsilon(0.001).scale(1.0));
+        }
+    }
+    // The shortest input with a signal value has one
+    const auto shortest = AARC::TA::macd(random_walk(34), 26, 12, 9);
+    CHECK(shortest.signal_.size() == 1);
+    CHECK(shortest.histogram_[0] == doctest::Approx(reference_macd(random_walk(34), 12, 26, 9).histogram_[0]));
+    CHECK(AARC::TA::macd(random_walk(33), 26, 12, 9).line_.empty());
+}
+
+TEST_CASE("EMA and RSI stay inside their input") {
+    for (const auto sz : {14, 15, 37, 1001, 65537}) {
+        const auto in  = random_walk(sz);
+        const auto out = AARC::TA::ema(in, 14);
+        const auto ref = reference_ema(in, 0, 14);
+        REQUIRE(out.size() == sz - 13);
+        for (auto i = size_t(0); i < out.size(); ++i) CHECK(out[i] == doctest::Approx(ref[13 + i]).epsilon(0.001));
+    }
+    CHECK(AARC::TA::ema(random_walk(13), 14).empty());
+
+    // Cutting the input short only drops the last values, none of them read past the end
+    const auto in   = random_walk(1001);
+    const auto full = AARC::TA::rsi(in, 14);
+    REQUIRE(full.size() == 1001 - 27);
+    for (const auto sz : {28, 29, 100, 500}) {
+        const auto part = AARC::TA::rsi(std::vector<float>(begin(in), begin(in) + sz), 14);
+        REQUIRE(part.size() == sz - 27);
+        for (auto i = size_t(0); i < part.size(); ++i) CHECK(part[i] == doctest::Approx(full[i]).epsilon(0.0001));
+    }
+}
+
+TEST_CASE("Rolling extrema and stochastic") {
+    const auto in = random_walk(5003);
+    for (const auto period : {1, 2, 5, 14, 100, 5003}) {
+        const auto hi = AARC::TA::rolling_max(in, period);
+        const auto lo = AARC::TA::rolling_min(in, period);
+        REQUIRE(hi.size() == in.size() - period + 1);
+        REQUIRE(lo.size() == in.size() - period + 1);
+        for (auto i = size_t(0); i < hi.size(); i += 7) {
+            CHECK(hi[i] == *std::max_element(begin(in) + i, begin(in) + i + period));
+            CHECK(lo[i] == *std::min_element(begin(in) + i, begin(in) + i + period));
+        }
+    }
+    CHECK(AARC::TA::rolling_max(in, 5004).empty());
+
+    auto bars = AARC::TSData();
+    for (auto i = size_t(0); i < in.size(); ++i) {
+        bars.ts_.emplace_back(i);
+        bars.open_.emplace_back(in[i]);
+        bars.high_.emplace_back(in[i] + 0.25f);
+        bars.low_.emplace_back(in[i] - 0.25f);
+        bars.close_.emplace_back(in[i]);
+    }
+    const auto st = AARC::TA::stoch(bars, 14, 3, 3);
+    REQUIRE(st.k_.size() == in.size() - 14 - 3 + 2);
+    REQUIRE(st.d_.size() == st.k_.size() - 2);
+    CHECK(std::all_of(begin(st.k_), end(st.k_), [](const float k) { return k >= 0.0f && k <= 100.0f; }));
+    // Fast %K at one bar by hand, bar 13 + 2 is the last of the three averaged into the first slow %K
+    const auto fast_k = [&bars](const size_t bar) {
+        const auto hh = *std::max_element(begin(bars.high_) + bar - 13, begin(bars.high_) + bar + 1);
+        const auto ll = *std::min_element(begin(bars.low_) + bar - 13, begin(bars.low_) + bar + 1);
+        return 100.0f * (bars.close_[bar] - ll) / (hh - ll);
+    };
+    CHECK(st.k_[0] == doctest::Approx((fast_k(13) + fast_k(14) + fast_k(15)) / 3.0f));
+    CHECK(st.d_[0] == doctest::Approx((st.k_[0] + st.k_[1] + st.k_[2]) / 3.0f));
+
+    const auto ch = AARC::TA::donchian(bars, 20);
+    REQUIRE(ch.upper_.size() == in.size() - 19);
+    CHECK(ch.middle_[10] == doctest::Approx((ch.upper_[10] + ch.lower_[10]) / 2.0f));
+    const auto signals = AARC::TA::breakout(bars, 20);
+    CHECK(signals.size() == ch.upper_.size() - 1);
+}
+
+TEST_CASE("Rolling statistics") {
+    // Offset the walk so a naive sum of squares would lose most of its precision in float
+    auto in = random_walk(4001);
+    for (auto &v : in) v += 10000.0f;
+    auto other = std::vector<float>(in.size());
+    for (auto i = size_t(0); i < other.size(); ++i) other[i] = std::cos(i * 0.11f) + std::sin(i * 0.013f) + i * 1e-3f;
+    const auto naive = [](const float *x, const float *y, const size_t n) {
+        auto mx = 0.0, my = 0.0;
+        for (auto i = size_t(0); i < n; ++i) mx += x[i], my += y[i];
+        mx /= n, my /= n;
+        auto vx = 0.0, vy = 0.0, c = 0.0;
+        for (auto i = size_t(0); i < n; ++i) {
+            vx += (x[i] - mx) * (x[i] - mx), vy += (y[i] - my) * (y[i] - my), c += (x[i] - mx) * (y[i] - my);
+        }
+        return std::make_tuple(mx, std::sqrt(vx / n), c / n, c / std::sqrt(vx * vy));
+    };
+    const auto periods = std::vector<size_t>{2, 20, 250};
+    const auto batch   = AARC::TA::rolling_stats(in, periods);
+    REQUIRE(batch.size() == periods.size());
+    for (auto p = size_t(0); p < periods.size(); ++p) {
+        const auto period = periods[p];
+        const auto &st    = batch[p];
+        const auto  rc    = AARC::TA::rolling_correlation(in, other, period);
+        REQUIRE(st.mean_.size() == in.size() - period + 1);
+        REQUIRE(rc.corr_.size() == st.mean_.size());
+        for (auto i = size_t(0); i < st.mean_.size(); i += 13) {
+            const auto expected = naive(in.data() + i, other.data() + i, period);
+            CHECK(st.mean_[i] == doctest::Approx(std::get<0>(expected)).epsilon(1e-6));
+            CHECK(st.stddev_[i] == doctest::Approx(std::get<1>(expected)).epsilon(1e-3));
+            CHECK(rc.cov_[i] == doctest::Approx(std::get<2>(expected)).epsilon(1e-3));
+            CHECK(rc.corr_[i] == doctest::Approx(std::get<3>(expected)).epsilon(1e-3));
+            CHECK(st.zscore_[i] == doctest::Approx((in[i + period - 1] - std::get<0>(expected)) /
+                                                   std::get<1>(expected))
+                                       .epsilon(1e-3));
+        }
+    }
+    CHECK(AARC::TA::rolling_correlation(in, in, 20).corr_[100] == doctest::Approx(1.0f));
+    CHECK(AARC::TA::rolling_correlation(in, std::vector<float>(10), 5).corr_.empty());
+
+    const auto sma = AARC::TA::sma(in, 20);
+    const auto bb  = AARC::TA::bollinger(in, 20, 2.0f);
+    REQUIRE(sma.size() == bb.middle_.size());
+    CHECK(sma[50] == doctest::Approx(std::accumulate(begin(in) + 50, begin(in) + 70, 0.0) / 20.0));
+    CHECK(bb.middle_[50] == doctest::Approx(sma[50]));
+    CHECK(bb.upper_[50] - bb.middle_[50] == doctest::Approx(bb.middle_[50] - bb.lower_[50]));
+
+    const auto vol = AARC::TA::rolling_volatility(in, 20);
+    CHECK(vol.size() == in.size() - 20);
+    CHECK(std::all_of(begin(vol), end(vol), [](const float v) { return v >= 0.0f; }));
+}
+
+TEST_CASE("Smooth outliers") {
+    const auto walk = random_walk(10000);
+    auto       bars = AARC::TSData();
+    for (auto i = size_t(0); i < walk.size(); ++i) {
+        bars.ts_.emplace_back(i);
+        bars.open_.emplace_back(walk[i]);
+        bars.high_.emplace_back(walk[i] + 0.1f);
+        bars.low_.emplace_back(walk[i] - 0.1f);
+        bars.close_.emplace_back(walk[i]);
+    }
+    // Bad ticks in single columns, including either side of a chunk boundary
+    const auto spikes = std::vector<size_t>{50, 4095, 4096, 7000};
+    for (const auto i : spikes) bars.close_[i] *= 1.2f;
+    bars.low_[3000] *= 0.5f;
+
+    const auto smooth = AARC::TA::smooth_outliers(bars, 0.01f);
+    const auto again  = AARC::TA::smooth_outliers(bars, 0.01f);
+    CHECK(smooth.close_ == again.close_);
+    CHECK(smooth.low_ == again.low_);
+    for (const auto i : spikes) {
+        // Trailing median lags the trend a little
+        CHECK(smooth.close_[i] == doctest::Approx(walk[i]).epsilon(0.05));
+        CHECK(smooth.high_[i] >= smooth.close_[i]);
+    }
+    CHECK(smooth.low_[3000] == doctest::Approx(walk[3000] - 0.1f).epsilon(0.05));
+    auto changed = size_t(0);
+    for (auto i = size_t(0); i < walk.size(); ++i) changed += smooth.close_[i] != bars.close_[i];
+    CHECK(changed == spikes.size());
+    CHECK(smooth.open_ == bars.open_);
+}
+
+TEST_CASE("MACD benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace std::chrono;
+    const auto in    = random_walk(10000000);
+    const auto start = high_resolution_clock::now();
+    const auto out   = AARC::TA::macd(in, 26, 12, 9);
+    const auto mid   = high_resolution_clock::now();
+    const auto ref   = reference_macd(in, 12, 26, 9);
+    const auto fin   = high_resolution_clock::now();
+    CHECK(out.histogram_.size() == ref.histogram_.size());
+    spdlog::get("logger")->info("MACD 10m bars vectorised {}ms scalar {}ms",
+                                duration_cast<milliseconds>(mid - start).count(),
+                                duration_cast<milliseconds>(fin - mid).count());
+}
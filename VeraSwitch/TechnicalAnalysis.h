@@ -10,13 +10,17 @@ namespace AARC {
         auto resample(const TSData &in, const int mins = 5 /* Resample to this time unit, in minutes */)
             -> AARC::TSData;
 
-        /* This takes the input data and averages out two consecutive data points that are >tolerance away from each
-         * other */
-        auto smooth_outliers(const TSData &in, const float tolerance) -> const TSData;
+        /* Hampel filter over all four price columns. A price more than n_sigmas robust deviations (scaled MAD) and
+        more than tolerance, as a fraction, away from the median of the trailing window bars is replaced by that
+        median. Only past bars are used so it is safe for backtesting, and the first window - 1 bars are left as they
+        are */
+        auto smooth_outliers(const TSData &in, const float tolerance, const size_t window = 11,
+                             const float n_sigmas = 3.0f) -> const TSData;
 
         /*
         Each TA has it's own set of parameters which we need to apply.
-        Only apply for visible area to save on cpu cycles
+        Only apply for visible area to save on cpu cycles, IndicatorGraph::evaluate does this for a bar range with
+        a WarmCache so scrolling only calculates what's on screen
         Note that TAs are variable independent so can be threaded
         */
 
@@ -32,18 +36,88 @@ namespace AARC {
         /* Talking a float array and calculates the histogram buckets , and returns as a tuple of bucket,count */
         auto histogram(const std::vector<float> &in, const float bucket_size) -> std::vector<size_t>;
 
-        /* RSI with parameters */
+        /* RSI with parameters, out[i] is the value at bar 2 * period - 1 + i */
         auto rsi(const std::vector<float> &in, const size_t period) -> std::vector<float>;
 
-        // auto stoch(const TSData &in, const size_t start, const size_t fin) -> vector<double>;
+        /* Highest/lowest value over the trailing period bars, O(n) whatever the period. out[i] is the window ending
+         * at bar period - 1 + i */
+        auto rolling_max(const std::vector<float> &in, const size_t period) -> std::vector<float>;
+        auto rolling_min(const std::vector<float> &in, const size_t period) -> std::vector<float>;
+
+        /* Stochastic oscillator. %K is where the close sits in the k_period high/low range, averaged over k_slowing
+        bars for the slow stochastic, and %D is the d_period average of %K. k_[i] is the value at bar
+        k_period + k_slowing - 2 + i and d_ starts d_period - 1 bars after that */
+        struct Stoch {
+            std::vector<float> k_;
+            std::vector<float> d_;
+        };
+        auto stoch(const TSData &in, const size_t k_period, const size_t d_period, const size_t k_slowing = 1)
+            -> Stoch;
+
+        /* Highest high/lowest low channel over period bars, out[i] is the value at bar period - 1 + i */
+        struct Donchian {
+            std::vector<float> upper_;
+            std::vector<float> lower_;
+            std::vector<float> middle_;
+        };
+        auto donchian(const TSData &in, const size_t period) -> Donchian;
+
+        /* 1 where the close breaks above the previous bar's Donchian channel, -1 where it breaks below and 0
+         * otherwise. out[i] is bar period + i */
+        auto breakout(const TSData &in, const size_t period) -> std::vector<int>;
+
+        /* Rolling mean, population standard deviation and the z-score of each window's last bar against the window,
+        all from one pass. out[i] is the window ending at bar period - 1 + i */
+        struct RollingStats {
+            std::vector<float> mean_;
+            std::vector<float> stddev_;
+            std::vector<float> zscore_;
+        };
+        auto rolling_stats(const std::vector<float> &in, const size_t period) -> RollingStats;
+        // Several window lengths over the same series, one result per period in the order given
+        auto rolling_stats(const std::vector<float> &in, const std::vector<size_t> &periods)
+            -> std::vector<RollingStats>;
+
+        /* Rolling covariance and correlation between two series aligned bar for bar, empty if the lengths differ */
+        struct RollingCorrelation {
+            std::vector<float> cov_;
+            std::vector<float> corr_;
+        };
+        auto rolling_correlation(const std::vector<float> &a, const std::vector<float> &b, const size_t period)
+            -> RollingCorrelation;
+
+        /* Bollinger bands, the period average +/- width standard deviations. out[i] is bar period - 1 + i */
+        struct Bollinger {
+            std::vector<float> upper_;
+            std::vector<float> middle_;
+            std::vector<float> lower_;
+        };
+        auto bollinger(const std::vector<float> &in, const size_t period, const float width = 2.0f) -> Bollinger;
+
+        /* Annualised close to close volatility, the sample deviation of the last period log returns scaled by
+         * sqrt(bars_per_year). out[i] is the value at bar period + i */
+        auto rolling_volatility(const std::vector<float> &in, const size_t period, const float bars_per_year = 252.0f)
+            -> std::vector<float>;
+
+        // Exponential average seeded with the simple average of the first period values, out[i] is bar period - 1 + i
         auto ema(const std::vector<float> &in, const size_t period) -> std::vector<float>;
 
+        // out[i] is the average of the period bars ending at bar period - 1 + i
         auto sma(const std::vector<float> &in, const size_t period) -> std::vector<float>;
 
         auto wma(const std::vector<float> &in, const size_t period) -> std::vector<float>;
 
+        /* MACD line (fast EMA - slow EMA), the signal line (EMA of the MACD line) and the histogram (line - signal).
+        The longer of upper_period and lower_period is the slow EMA. line_[i] is the value at bar
+        max(upper_period, lower_period) - 1 + i, the signal and histogram start crossover_period - 1 bars after the
+        line */
+        struct MACD {
+            std::vector<float> line_;
+            std::vector<float> signal_;
+            std::vector<float> histogram_;
+        };
         auto macd(const std::vector<float> &in, const size_t upper_period, const size_t lower_period,
-                  const size_t crossover_period) -> std::vector<float>;
+                  const size_t crossover_period) -> MACD;
 
         /* Scale between -1 and 1 */
         auto scale(const std::vector<float> &in, const float a = -1.0f, const float b = 1.0f) noexcept
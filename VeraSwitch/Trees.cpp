@@ -0,0 +1,452 @@
+#include "Trees.h"
+#include "Random.h"
+#include "Split.h"
+#include "TechnicalAnalysis.h"
+#include "TimeSeries.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <limits>
+#include <numeric>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+namespace {
+    using namespace AARC::Trees;
+
+    // Rows per task when applying trees
+    constexpr size_t chunk = 4096;
+    // Values per feature the bin edges are taken from
+    constexpr size_t edge_sample = 65536;
+    // Bin of a leaf, above every code so a leaf always steps to itself
+    constexpr int32_t leaf_bin = 255;
+
+    // Each feature's values as the bin they fall in, code = number of edges below the value
+    struct Binned {
+        size_t                          rows_ = 0;
+        std::vector<uint8_t>            codes_; // codes_[f * rows_ + i]
+        std::vector<std::vector<float>> edges_;
+    };
+
+    auto binned(const Matrix &m, const size_t bins) -> Binned {
+        using namespace std;
+        auto out = Binned{m.rows_, vector<uint8_t>(m.rows_ * m.features_), vector<vector<float>>(m.features_)};
+        concurrency::parallel_for(size_t(0), m.features_, [&](const size_t f) {
+            const auto *x      = m.x_.data() + f * m.rows_;
+            const auto  step   = max<size_t>(1, m.rows_ / edge_sample);
+            auto        sample = vector<float>();
+            for (auto i = size_t(0); i < m.rows_; i += step) {
+                if (!isnan(x[i])) sample.emplace_back(x[i]);
+            }
+            sort(begin(sample), end(sample));
+            auto &edges = out.edges_[f];
+            for (auto k = size_t(1); k < bins && !sample.empty(); ++k) {
+                const auto v = sample[k * sample.size() / bins];
+                if (edges.empty() || v > edges.back()) edges.emplace_back(v);
+            }
+            for (auto i = size_t(0); i < m.rows_; ++i) {
+                const auto code             = lower_bound(begin(edges), end(edges), x[i]) - begin(edges);
+                out.codes_[f * m.rows_ + i] = static_cast<uint8_t>(code);
+            }
+        });
+        return out;
+    }
+
+    // A tree as it is grown, nodes breadth first
+    struct Tree {
+        std::vector<int32_t> feature_;
+        std::vector<int32_t> bin_;
+        std::vector<float>   threshold_;
+        std::vector<int32_t> child_;
+        std::vector<float>   value_;
+        int32_t              depth_ = 0;
+    };
+
+    struct Split {
+        double  gain_    = 0.0;
+        int32_t feature_ = -1;
+        int32_t bin_     = 0;
+    };
+
+    // Best split of rows[lo, hi) from gradient histograms, one feature per task
+    auto best_split(const Binned &b, const std::vector<double> &g, const std::vector<double> &h,
+                    const std::vector<uint32_t> &rows, const size_t lo, const size_t hi, const double sum_g,
+                    const double sum_h, const std::vector<size_t> &tried, const Settings &s, const double lambda)
+        -> Split {
+        using namespace std;
+        auto       found  = vector<Split>(tried.size());
+        const auto parent = sum_g * sum_g / (sum_h + lambda);
+        concurrency::parallel_for(size_t(0), tried.size(), [&](const size_t j) {
+            const auto  f     = tried[j];
+            const auto  nbins = b.edges_[f].size() + 1;
+            const auto *codes = b.codes_.data() + f * b.rows_;
+            auto        hg = vector<double>(nbins, 0.0), hh = vector<double>(nbins, 0.0);
+            auto        hn = vector<size_t>(nbins, 0);
+            for (auto i = lo; i < hi; ++i) {
+                const auto r = size_t(rows[i]), c = size_t(codes[r]);
+                hg[c] += g[r];
+                hh[c] += h[r];
+                ++hn[c];
+            }
+            auto gl = 0.0, hl = 0.0;
+            auto nl = size_t(0);
+            for (auto k = size_t(0); k + 1 < nbins; ++k) {
+                gl += hg[k];
+                hl += hh[k];
+                nl += hn[k];
+                if (nl < s.min_leaf_ || hi - lo - nl < s.min_leaf_) continue;
+                const auto gr = sum_g - gl, hr = sum_h - hl;
+                const auto gain = gl * gl / (hl + lambda) + gr * gr / (hr + lambda) - parent;
+                if (gain > found[j].gain_) found[j] = Split{gain, static_cast<int32_t>(f), static_cast<int32_t>(k)};
+            }
+        });
+        auto best = Split();
+        for (const auto &f : found) {
+            if (f.gain_ > best.gain_ + 1e-12) best = f;
+        }
+        return best;
+    }
+
+    /* Grows one tree on the rows (repeats allowed) to fit the gradients, level by level. Leaf values are the second
+     * order step -G / (H + lambda) times shrink */
+    auto grow(const Binned &b, const std::vector<double> &g, const std::vector<double> &h, std::vector<uint32_t> rows,
+              const size_t features, const Settings &s, const double lambda, const double shrink,
+              AARC::Random::Stream &stream) -> Tree {
+        using namespace std;
+        struct Pending {
+            size_t  lo_, hi_;
+            int32_t depth_;
+        };
+        auto       t       = Tree();
+        auto       pending = vector<Pending>{Pending{0, rows.size(), 0}};
+        const auto tries   = max<size_t>(1, static_cast<size_t>(s.feature_fraction_ * features + 0.5));
+        auto       tried   = vector<size_t>(features);
+        auto       u       = vector<double>(features);
+        for (auto n = size_t(0); n < pending.size(); ++n) {
+            const auto p = pending[n];
+            t.feature_.resize(pending.size());
+            t.bin_.resize(pending.size());
+            t.threshold_.resize(pending.size());
+            t.child_.resize(pending.size());
+            t.value_.resize(pending.size());
+            auto sum_g = 0.0, sum_h = 0.0;
+            for (auto i = p.lo_; i < p.hi_; ++i) {
+                sum_g += g[rows[i]];
+                sum_h += h[rows[i]];
+            }
+            auto split = Split();
+            if (size_t(p.depth_) < s.max_depth_ && p.hi_ - p.lo_ >= 2 * s.min_leaf_) {
+                // A random subset of the features, the first tries of a shuffle
+                iota(begin(tried), end(tried), size_t(0));
+                if (tries < features) {
+                    AARC::Random::uniform(stream, u.data(), tries);
+                    for (auto k = size_t(0); k < tries; ++k) {
+                        swap(tried[k], tried[k + static_cast<size_t>(u[k] * (features - k))]);
+                    }
+                }
+                split = best_split(b, g, h, rows, p.lo_, p.hi_, sum_g, sum_h,
+                                   vector<size_t>(begin(tried), begin(tried) + tries), s, lambda);
+            }
+            if (split.feature_ < 0) {
+                t.feature_[n]   = 0;
+                t.bin_[n]       = leaf_bin;
+                t.threshold_[n] = numeric_limits<float>::infinity();
+                t.child_[n]     = static_cast<int32_t>(n);
+                t.value_[n]     = static_cast<float>(-sum_g / (sum_h + lambda) * shrink);
+                continue;
+            }
+            const auto *codes = b.codes_.data() + split.feature_ * b.rows_;
+            const auto  mid   = partition(begin(rows) + p.lo_, begin(rows) + p.hi_,
+                                       [&](const uint32_t r) { return codes[r] <= split.bin_; }) -
+                             begin(rows);
+            t.feature_[n]   = split.feature_;
+            t.bin_[n]       = split.bin_;
+            t.threshold_[n] = b.edges_[split.feature_][split.bin_];
+            t.child_[n]     = static_cast<int32_t>(pending.size());
+            t.depth_        = max(t.depth_, p.depth_ + 1);
+            pending.emplace_back(Pending{p.lo_, size_t(mid), p.depth_ + 1});
+            pending.emplace_back(Pending{size_t(mid), p.hi_, p.depth_ + 1});
+        }
+        return t;
+    }
+
+    // Adds the tree's leaf values for every row to f, walking on the binned codes
+    auto apply(const Tree &t, const Binned &b, std::vector<double> &f) -> void {
+        concurrency::parallel_for(size_t(0), (b.rows_ + chunk - 1) / chunk, [&](const size_t c) {
+            for (auto i = c * chunk; i < std::min(b.rows_, (c + 1) * chunk); ++i) {
+                auto node = 0;
+                for (auto d = 0; d < t.depth_; ++d) {
+                    node = t.child_[node] + (b.codes_[t.feature_[node] * b.rows_ + i] > t.bin_[node] ? 1 : 0);
+                }
+                f[i] += t.value_[node];
+            }
+        });
+    }
+
+    auto flatten(const std::vector<Tree> &trees, Ensemble &e) -> void {
+        for (const auto &t : trees) {
+            const auto root = static_cast<int32_t>(e.feature_.size());
+            e.root_.emplace_back(root);
+            e.depth_.emplace_back(t.depth_);
+            e.feature_.insert(end(e.feature_), begin(t.feature_), end(t.feature_));
+            e.threshold_.insert(end(e.threshold_), begin(t.threshold_), end(t.threshold_));
+            e.value_.insert(end(e.value_), begin(t.value_), end(t.value_));
+            for (const auto c : t.child_) e.child_.emplace_back(root + c);
+        }
+    }
+
+    auto valid(const Matrix &m, const std::vector<float> &target, const Settings &s, MethodLogger &mlog) -> bool {
+        if (m.x_.size() != m.rows_ * m.features_ || target.size() != m.rows_ || m.rows_ == 0 || m.features_ == 0) {
+            mlog.logger()->error("{} values and {} targets for {} rows of {} features", m.x_.size(), target.size(),
+                                 m.rows_, m.features_);
+            return false;
+        }
+        if (s.bins_ < 2 || s.bins_ > 256 || m.rows_ > std::numeric_limits<uint32_t>::max()) {
+            mlog.logger()->error("{} bins for {} rows", s.bins_, m.rows_);
+            return false;
+        }
+        return true;
+    }
+} // namespace
+
+auto AARC::Trees::random_forest(const Matrix &m, const std::vector<float> &target, const Settings &settings)
+    -> Ensemble {
+    using namespace std;
+    MethodLogger mlog("Trees::random_forest");
+    auto         out = Ensemble();
+    if (!valid(m, target, settings, mlog)) return out;
+    out.features_ = m.features_;
+    const auto b  = binned(m, settings.bins_);
+    // Fitting the target itself, -G / H is the mean of a leaf's targets
+    auto g = vector<double>(m.rows_), h = vector<double>(m.rows_, 1.0);
+    transform(begin(target), end(target), begin(g), [](const float y) { return -double(y); });
+    const auto sample = max<size_t>(1, static_cast<size_t>(settings.row_fraction_ * m.rows_));
+    auto       trees  = vector<Tree>(settings.trees_);
+    concurrency::parallel_for(size_t(0), settings.trees_, [&](const size_t t) {
+        auto stream = AARC::Random::Stream{settings.seed_, t};
+        auto u      = vector<double>(sample);
+        AARC::Random::uniform(stream, u.data(), sample);
+        auto rows = vector<uint32_t>(sample);
+        transform(begin(u), end(u), begin(rows), [&](const double v) { return static_cast<uint32_t>(v * m.rows_); });
+        trees[t] = grow(b, g, h, move(rows), m.features_, settings, 0.0, 1.0 / settings.trees_, stream);
+    });
+    flatten(trees, out);
+    return out;
+}
+
+auto AARC::Trees::boost(const Matrix &m, const std::vector<float> &target, const Settings &settings) -> Ensemble {
+    using namespace std;
+    MethodLogger mlog("Trees::boost");
+    auto         out = Ensemble();
+    if (!valid(m, target, settings, mlog)) return out;
+    out.loss_     = settings.loss_;
+    out.features_ = m.features_;
+    const auto b  = binned(m, settings.bins_);
+    const auto n  = m.rows_;
+    const auto logistic = settings.loss_ == Loss::LOGISTIC;
+
+    // Start from the best constant, the mean or its log odds
+    auto mean = 0.0;
+    for (const auto y : target) mean += y;
+    mean /= n;
+    if (logistic) {
+        mean = min(max(mean, 1e-6), 1.0 - 1e-6);
+        mean = log(mean / (1.0 - mean));
+    }
+    out.base_  = static_cast<float>(mean);
+    auto f     = vector<double>(n, mean);
+    auto g     = vector<double>(n), h = vector<double>(n, 1.0);
+    auto trees = vector<Tree>();
+    for (auto t = size_t(0); t < settings.trees_; ++t) {
+        concurrency::parallel_for(size_t(0), (n + chunk - 1) / chunk, [&](const size_t c) {
+            for (auto i = c * chunk; i < min(n, (c + 1) * chunk); ++i) {
+                if (logistic) {
+                    const auto p = 1.0 / (1.0 + exp(-f[i]));
+                    g[i]         = p - target[i];
+                    h[i]         = max(p * (1.0 - p), 1e-6);
+                } else {
+                    g[i] = f[i] - target[i];
+                }
+            }
+        });
+        auto stream = AARC::Random::Stream{settings.seed_, t};
+        auto rows   = vector<uint32_t>();
+        if (settings.row_fraction_ < 1.0) {
+            auto u = vector<double>(n);
+            AARC::Random::uniform(stream, u.data(), n);
+            for (auto i = size_t(0); i < n; ++i) {
+                if (u[i] < settings.row_fraction_) rows.emplace_back(static_cast<uint32_t>(i));
+            }
+        } else {
+            rows.resize(n);
+            iota(begin(rows), end(rows), uint32_t(0));
+        }
+        trees.emplace_back(
+            grow(b, g, h, move(rows), m.features_, settings, settings.lambda_, settings.learning_rate_, stream));
+        apply(trees.back(), b, f);
+    }
+    flatten(trees, out);
+    return out;
+}
+
+auto AARC::Trees::predict(const Ensemble &e, const Matrix &m) -> std::vector<float> {
+    using namespace std;
+    MethodLogger mlog("Trees::predict");
+    if (m.features_ != e.features_ || m.x_.size() != m.rows_ * m.features_) {
+        mlog.logger()->error("{} features for an ensemble of {}", m.features_, e.features_);
+        return vector<float>();
+    }
+    auto out = vector<float>(m.rows_);
+    concurrency::parallel_for(size_t(0), (m.rows_ + chunk - 1) / chunk, [&](const size_t c) {
+        const auto first = c * chunk, count = min(chunk, m.rows_ - first);
+        ispc::forest_predict(m.x_.data() + first, count, m.rows_, e.feature_.data(), e.threshold_.data(),
+                             e.child_.data(), e.value_.data(), e.root_.data(), e.depth_.data(), e.root_.size(),
+                             e.base_, out.data() + first);
+        if (e.loss_ == Loss::LOGISTIC) {
+            for (auto i = first; i < first + count; ++i) out[i] = 1.0f / (1.0f + exp(-out[i]));
+        }
+    });
+    return out;
+}
+
+namespace {
+    // Uniform features in [0, 1), the target a step function of the first two plus noise, the third is noise
+    auto steps(const size_t rows, const uint64_t seed, std::vector<float> &target) -> Matrix {
+        auto u = std::vector<double>(4 * rows);
+        auto s = AARC::Random::Stream{seed};
+        AARC::Random::uniform(s, u.data(), u.size());
+        auto m = Matrix{rows, 3, std::vector<float>(3 * rows)};
+        target.resize(rows);
+        for (auto i = size_t(0); i < rows; ++i) {
+            for (auto f = size_t(0); f < 3; ++f) m.x_[f * rows + i] = float(u[4 * i + f]);
+            target[i] = (u[4 * i] > 0.5 ? 1.0f : 0.0f) + (u[4 * i + 1] > 0.3 ? 0.5f : 0.0f) +
+                        float(0.2 * (u[4 * i + 3] - 0.5));
+        }
+        return m;
+    }
+
+    // Reference walk down the flat arrays, stopping at a leaf
+    auto walk(const Ensemble &e, const Matrix &m, const size_t i) -> float {
+        auto sum = e.base_;
+        for (const auto root : e.root_) {
+            auto node = root;
+            while (e.child_[node] != node) {
+                node = e.child_[node] + (m.x_[e.feature_[node] * m.rows_ + i] > e.threshold_[node] ? 1 : 0);
+            }
+            sum += e.value_[node];
+        }
+        return sum;
+    }
+
+    auto mse(const std::vector<float> &a, const std::vector<float> &b) -> double {
+        auto s = 0.0;
+        for (auto i = size_t(0); i < a.size(); ++i) s += (a[i] - b[i]) * (a[i] - b[i]);
+        return s / a.size();
+    }
+} // namespace
+
+TEST_CASE("Trees regression") {
+    using namespace AARC::Trees;
+    auto       y = std::vector<float>(), test_y = std::vector<float>();
+    const auto m = steps(20000, 1, y), test = steps(5000, 2, test_y);
+    // Noise variance 0.04 / 12, what a perfect model leaves
+    auto settings   = Settings();
+    settings.trees_ = 50;
+    const auto gbt  = boost(m, y, settings);
+    REQUIRE(gbt.root_.size() == 50);
+    CHECK(gbt.base_ == doctest::Approx(0.5 + 0.35).epsilon(0.02));
+    // The first split is the biggest step
+    CHECK(gbt.feature_[0] == 0);
+    CHECK(gbt.threshold_[0] == doctest::Approx(0.5f).epsilon(0.03));
+    const auto p = predict(gbt, test);
+    CHECK(mse(p, test_y) < 0.01);
+    for (auto i = size_t(0); i < 5000; i += 499) CHECK(p[i] == doctest::Approx(walk(gbt, test, i)).epsilon(1e-5));
+
+    settings.feature_fraction_ = 2.0 / 3.0;
+    settings.max_depth_        = 8;
+    const auto rf              = random_forest(m, y, settings);
+    const auto q               = predict(rf, test);
+    CHECK(mse(q, test_y) < 0.01);
+    for (auto i = size_t(0); i < 5000; i += 499) CHECK(q[i] == doctest::Approx(walk(rf, test, i)).epsilon(1e-5));
+    // Same seed same forest
+    CHECK(random_forest(m, y, settings).threshold_ == rf.threshold_);
+
+    CHECK(predict(gbt, Matrix{1, 2, {0.0f, 0.0f}}).empty());
+}
+
+TEST_CASE("Trees classification") {
+    using namespace AARC::Trees;
+    // Up when the sum of the two features is over 1, with one label in ten flipped
+    const auto make = [](const size_t rows, const uint64_t seed, std::vector<float> &y) {
+        auto u = std::vector<double>(3 * rows);
+        auto s = AARC::Random::Stream{seed};
+        AARC::Random::uniform(s, u.data(), u.size());
+        auto m = Matrix{rows, 2, std::vector<float>(2 * rows)};
+        y.resize(rows);
+        for (auto i = size_t(0); i < rows; ++i) {
+            m.x_[i]        = float(u[3 * i]);
+            m.x_[rows + i] = float(u[3 * i + 1]);
+            y[i]           = ((u[3 * i] + u[3 * i + 1] > 1.0) != (u[3 * i + 2] < 0.1)) ? 1.0f : 0.0f;
+        }
+        return m;
+    };
+    auto       y = std::vector<float>(), test_y = std::vector<float>();
+    const auto m = make(20000, 3, y), test = make(5000, 4, test_y);
+    auto       settings     = Settings();
+    settings.loss_          = Loss::LOGISTIC;
+    settings.row_fraction_  = 0.7;
+    settings.learning_rate_ = 0.2;
+    const auto p            = predict(boost(m, y, settings), test);
+    auto       right        = size_t(0);
+    for (auto i = size_t(0); i < p.size(); ++i) right += (p[i] > 0.5f) == (test_y[i] > 0.5f);
+    CHECK(right > 0.86 * p.size());
+    CHECK(*std::min_element(begin(p), end(p)) >= 0.0f);
+    CHECK(*std::max_element(begin(p), end(p)) <= 1.0f);
+}
+
+TEST_CASE("Trees on TA features") {
+    using namespace AARC::Trees;
+    const auto bars = AARC::Random::walk(6000, 8);
+    // TA outputs end at the last bar, the forward returns start at the first
+    const auto rsi  = AARC::TA::rsi(bars.close_, 14);
+    const auto k    = AARC::TA::stoch(bars, 14, 3).k_;
+    const auto fwd  = AARC::TA::period_returns(bars, 5, AARC::TA::PeriodReturnType::CLOSECLOSE);
+    const auto n    = bars.ts_.size();
+    const auto from = n - std::min(rsi.size(), k.size()), rows = fwd.size() - from;
+    auto       m    = Matrix{rows, 2, std::vector<float>(2 * rows)};
+    auto       up   = std::vector<float>(rows);
+    for (auto i = size_t(0); i < rows; ++i) {
+        m.x_[i]        = rsi[from + i - (n - rsi.size())];
+        m.x_[rows + i] = k[from + i - (n - k.size())];
+        up[i]          = fwd[from + i] > 0.0f ? 1.0f : 0.0f;
+    }
+    auto settings   = Settings();
+    settings.loss_  = Loss::LOGISTIC;
+    settings.trees_ = 20;
+    const auto p    = predict(boost(m, up, settings), m);
+    REQUIRE(p.size() == rows);
+    // Nothing to learn in a random walk beyond noise, the probabilities stay close to a half
+    const auto mean = std::accumulate(begin(p), end(p), 0.0) / rows;
+    CHECK(mean == doctest::Approx(0.5).epsilon(0.1));
+}
+
+TEST_CASE("Trees benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::Trees;
+    using namespace std::chrono;
+    auto       y        = std::vector<float>();
+    const auto m        = steps(100000, 5, y);
+    auto       settings = Settings();
+    auto       start    = high_resolution_clock::now();
+    const auto gbt      = boost(m, y, settings);
+    const auto train_ms = duration_cast<milliseconds>(high_resolution_clock::now() - start).count();
+    auto       test_y   = std::vector<float>();
+    const auto test     = steps(1000000, 6, test_y);
+    start               = high_resolution_clock::now();
+    const auto p        = predict(gbt, test);
+    const auto us       = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    CHECK(p.size() == 1000000);
+    spdlog::get("logger")->info("Trees 100 trees depth 6 train 100k rows {}ms, score 1m rows {}us ({} rows/s)",
+                                train_ms, us, us > 0 ? 1000000LL * 1000000LL / us : 0);
+}
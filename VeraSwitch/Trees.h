@@ -0,0 +1,58 @@
+#pragma once
+#include "Features.h"
+#include <cstdint>
+#include <vector>
+
+namespace AARC {
+    namespace Trees {
+        /* Random forests and gradient boosted trees over a matrix of features, TA outputs lined up bar for bar with a
+        target such as the forward return. Features are binned once into at most 256 quantile bins and a node's split
+        is found from per-bin histograms of the gradients, each feature's in parallel. Both ensembles are grown by
+        the same second order builder: a forest's trees fit the target directly from bootstrap samples and are
+        averaged, boosted trees each fit the gradient of the loss left by the trees before.
+        A trained ensemble is flat arrays, one per node field, with each tree breadth first so its top levels share
+        cache lines, and scoring walks every row down a tree a fixed number of steps */
+
+        // x_[f * rows_ + i] is feature f of row i
+        using Matrix = Features::Matrix;
+
+        enum class Loss {
+            SQUARED, // Regression, the prediction is the expected target
+            LOGISTIC // Targets 0 or 1, the prediction is the probability of 1
+        };
+
+        struct Settings {
+            Loss     loss_             = Loss::SQUARED;
+            size_t   trees_            = 100;
+            size_t   max_depth_        = 6;
+            size_t   min_leaf_         = 20;  // Rows
+            size_t   bins_             = 64;  // Up to 256
+            double   lambda_           = 1.0; // L2 penalty on leaf values, boosting only
+            double   learning_rate_    = 0.1; // Boosting only
+            double   row_fraction_     = 1.0; // Forest bootstrap size or boosting subsample, as a fraction of the rows
+            double   feature_fraction_ = 1.0; // Features tried at each node, forests usually want about 1 / sqrt
+            uint64_t seed_             = 1;
+        };
+
+        // Node n of the ensemble splits on feature_[n] at threshold_[n], see forest_predict
+        struct Ensemble {
+            Loss                 loss_     = Loss::SQUARED;
+            size_t               features_ = 0;
+            float                base_     = 0.0f; // Added to the sum of the leaves
+            std::vector<int32_t> feature_;
+            std::vector<float>   threshold_;
+            std::vector<int32_t> child_;
+            std::vector<float>   value_;
+            std::vector<int32_t> root_;
+            std::vector<int32_t> depth_;
+        };
+
+        // The trees' average, whatever the loss. With 0 or 1 targets that is already the probability of 1
+        auto random_forest(const Matrix &m, const std::vector<float> &target, const Settings &settings = Settings())
+            -> Ensemble;
+        auto boost(const Matrix &m, const std::vector<float> &target, const Settings &settings = Settings())
+            -> Ensemble;
+
+        auto predict(const Ensemble &e, const Matrix &m) -> std::vector<float>;
+    } // namespace Trees
+} // namespace AARC
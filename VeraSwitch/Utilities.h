@@ -54,6 +54,22 @@ inline auto split_iter(const std::string &s, char delim)
     return result;
 }
 
+namespace AARC {
+    // Four running sums so the compiler can keep the multiply-adds in flight without reordering a single sum
+    inline auto dot(const double *a, const double *b, const size_t n) -> double {
+        auto s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+        auto i  = size_t(0);
+        for (; i + 4 <= n; i += 4) {
+            s0 += a[i] * b[i];
+            s1 += a[i + 1] * b[i + 1];
+            s2 += a[i + 2] * b[i + 2];
+            s3 += a[i + 3] * b[i + 3];
+        }
+        for (; i < n; ++i) s0 += a[i] * b[i];
+        return (s0 + s1) + (s2 + s3);
+    }
+} // namespace AARC
+
 // Only used in tracing mode to figure out our call stack
 class MethodLogger {
   public:
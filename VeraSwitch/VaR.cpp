@@ -0,0 +1,201 @@
+#include "VaR.h"
+#include "Align.h"
+#include "Covariance.h"
+#include "Random.h"
+#include "TimeSeriesFactory.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <numeric>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+namespace {
+    // Lower triangular factor of an n x n covariance, row-major. A direction with no variance left (collinear
+    // assets or too short a window) gets a zero column instead of failing
+    auto cholesky(const std::vector<double> &cov, const size_t n) -> std::vector<double> {
+        using namespace std;
+        auto l = vector<double>(n * n, 0.0);
+        for (auto j = size_t(0); j < n; ++j) {
+            auto d = cov[j * n + j];
+            for (auto k = size_t(0); k < j; ++k) d -= l[j * n + k] * l[j * n + k];
+            const auto pivot = d > 1e-14 * max(cov[j * n + j], 1e-300) ? sqrt(d) : 0.0;
+            l[j * n + j]     = pivot;
+            for (auto i = j + 1; i < n; ++i) {
+                auto s = cov[i * n + j];
+                for (auto k = size_t(0); k < j; ++k) s -= l[i * n + k] * l[j * n + k];
+                l[i * n + j] = pivot > 0.0 ? s / pivot : 0.0;
+            }
+        }
+        return l;
+    }
+} // namespace
+
+auto AARC::VaR::returns(const std::vector<TSData> &series) -> Returns {
+    using namespace std;
+    // Closes on the timestamps every series has
+    const auto panel = Align::align(series, Align::Fill::DROP);
+    auto       out   = Returns();
+    out.assets_      = panel.assets_;
+    if (panel.ts_.size() < 2) return out;
+    const auto n = series.size(), t = panel.ts_.size() - 1;
+    out.ts_.assign(begin(panel.ts_) + 1, end(panel.ts_));
+    out.r_.resize(t * n);
+    for (auto a = size_t(0); a < n; ++a) {
+        const auto *close = panel.column(a);
+        for (auto i = size_t(0); i < t; ++i) out.r_[i * n + a] = log(double(close[i + 1]) / double(close[i]));
+    }
+    return out;
+}
+
+auto AARC::VaR::load(const std::string &db, const std::vector<uint64_t> &assets, const uint64_t start,
+                     const uint64_t end, const int units) -> Returns {
+    auto series = std::vector<TSData>(assets.size());
+    concurrency::parallel_for(size_t(0), assets.size(), [&](const size_t a) {
+        series[a] = std::move(*TimeSeriesFactory::select(db, assets[a], start, end, units));
+    });
+    return returns(series);
+}
+
+auto AARC::VaR::measure(std::vector<double> &losses, const double confidence) -> Measures {
+    using namespace std;
+    const auto n = losses.size();
+    if (n == 0) return Measures();
+    // Only the tail needs ordering, the worst k are moved to the front
+    const auto k = max<size_t>(1, static_cast<size_t>((1.0 - confidence) * n + 1e-9));
+    nth_element(begin(losses), begin(losses) + (k - 1), end(losses), greater<double>());
+    const auto var = *max_element(begin(losses) + (k - 1), begin(losses) + k);
+    const auto es  = accumulate(begin(losses), begin(losses) + k, 0.0) / k;
+    return Measures{var, es, n};
+}
+
+auto AARC::VaR::historical(const Returns &returns, const std::vector<double> &exposures, const double confidence)
+    -> Measures {
+    using namespace std;
+    MethodLogger mlog("VaR::historical");
+    const auto n = returns.assets_.size();
+    if (exposures.size() != n) {
+        mlog.logger()->error("{} exposures for {} assets", exposures.size(), n);
+        return Measures();
+    }
+    const auto t      = returns.ts_.size();
+    auto       losses = vector<double>(t);
+    const auto chunk  = size_t(1024);
+    concurrency::parallel_for(size_t(0), (t + chunk - 1) / chunk, [&](const size_t c) {
+        for (auto i = c * chunk; i < min(t, (c + 1) * chunk); ++i) {
+            auto pnl = 0.0;
+            for (auto a = size_t(0); a < n; ++a) pnl += exposures[a] * expm1(returns.r_[i * n + a]);
+            losses[i] = -pnl;
+        }
+    });
+    return measure(losses, confidence);
+}
+
+auto AARC::VaR::monte_carlo(const Returns &returns, const std::vector<double> &exposures, const double confidence,
+                            const size_t paths, const size_t window, const uint64_t seed) -> Measures {
+    using namespace std;
+    MethodLogger mlog("VaR::monte_carlo");
+    const auto n = returns.assets_.size();
+    if (exposures.size() != n || returns.ts_.size() < 2) {
+        mlog.logger()->error("{} exposures for {} assets over {} returns", exposures.size(), n, returns.ts_.size());
+        return Measures();
+    }
+    const auto t     = returns.ts_.size();
+    const auto w     = window == 0 ? t : min(window, t);
+    const auto *rows = returns.r_.data() + (t - w) * n;
+    const auto  est  = Covariance::sample(rows, w, n);
+    const auto &mean = est.mean_;
+    const auto  l    = cholesky(est.cov_, n);
+
+    // Block b of paths always draws from random stream b
+    const auto block  = size_t(4096);
+    auto       losses = vector<double>(paths);
+    concurrency::parallel_for(size_t(0), (paths + block - 1) / block, [&](const size_t b) {
+        const auto count  = min(block, paths - b * block);
+        auto       stream = AARC::Random::Stream{seed, b};
+        auto       z      = vector<double>(count * n);
+        AARC::Random::normal(stream, z.data(), z.size());
+        for (auto p = size_t(0); p < count; ++p) {
+            const auto *zp  = z.data() + p * n;
+            auto        pnl = 0.0;
+            for (auto i = size_t(0); i < n; ++i) {
+                pnl += exposures[i] * expm1(mean[i] + dot(l.data() + i * n, zp, i + 1));
+            }
+            losses[b * block + p] = -pnl;
+        }
+    });
+    return measure(losses, confidence);
+}
+
+namespace {
+    // Correlated daily closes driven by one market factor, plus each asset's own noise
+    auto market(const size_t assets, const size_t days, const double beta, const double vol)
+        -> std::vector<AARC::TSData> {
+        auto series = std::vector<AARC::TSData>(assets);
+        auto stream = AARC::Random::Stream{7};
+        auto z      = std::vector<double>(days * (assets + 1));
+        AARC::Random::normal(stream, z.data(), z.size());
+        for (auto a = size_t(0); a < assets; ++a) {
+            series[a].asset_ = a;
+            auto log_price   = std::log(100.0);
+            for (auto d = size_t(0); d < days; ++d) {
+                const auto m = z[d * (assets + 1)], e = z[d * (assets + 1) + 1 + a];
+                log_price += vol * (beta * m + std::sqrt(1.0 - beta * beta) * e);
+                series[a].ts_.emplace_back(1000 + d);
+                series[a].close_.emplace_back(static_cast<float>(std::exp(log_price)));
+            }
+        }
+        return series;
+    }
+} // namespace
+
+TEST_CASE("VaR against the normal distribution") {
+    using namespace AARC::VaR;
+    auto series = market(5, 20001, 0.6, 0.01);
+    // A day missing from one asset drops it for all of them, the return spans the gap
+    series[2].ts_.erase(series[2].ts_.begin() + 10);
+    series[2].close_.erase(series[2].close_.begin() + 10);
+    const auto r = returns(series);
+    REQUIRE(r.assets_.size() == 5);
+    CHECK(r.ts_.size() == 19999);
+    CHECK(std::find(begin(r.ts_), end(r.ts_), 1010) == end(r.ts_));
+
+    // Equal exposure of 1m, portfolio vol from the factor structure
+    const auto exposures = std::vector<double>(5, 1e6);
+    const auto var_each  = 0.01 * 0.01;
+    const auto sigma     = 1e6 * std::sqrt(5 * var_each + 20 * 0.36 * var_each);
+    const auto h         = historical(r, exposures, 0.99);
+    CHECK(h.scenarios_ == r.ts_.size());
+    CHECK(h.var_ == doctest::Approx(2.326 * sigma).epsilon(0.05));
+    CHECK(h.es_ == doctest::Approx(2.665 * sigma).epsilon(0.05));
+    const auto mc = monte_carlo(r, exposures, 0.99, 200000, 0);
+    CHECK(mc.var_ == doctest::Approx(2.326 * sigma).epsilon(0.03));
+    CHECK(mc.es_ == doctest::Approx(2.665 * sigma).epsilon(0.03));
+    CHECK(mc.es_ > mc.var_);
+    // A hedged book has little risk
+    const auto hedged = historical(r, std::vector<double>{1e6, -1e6, 0, 0, 0}, 0.99);
+    CHECK(hedged.var_ < 0.5 * h.var_);
+
+    auto losses = std::vector<double>{5, 1, 3, 2, 4, 10, 0, 6, 7, 8};
+    const auto m = measure(losses, 0.8);
+    CHECK(m.var_ == 8.0);
+    CHECK(m.es_ == 9.0);
+}
+
+TEST_CASE("VaR benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::VaR;
+    using namespace std::chrono;
+    const auto r         = returns(market(300, 2501, 0.5, 0.015));
+    const auto exposures = std::vector<double>(300, 1e5);
+    auto       start     = high_resolution_clock::now();
+    const auto h         = historical(r, exposures);
+    const auto hist_us   = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    start                = high_resolution_clock::now();
+    const auto mc        = monte_carlo(r, exposures, 0.99, 20000);
+    const auto mc_us     = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+    CHECK(h.var_ > 0.0);
+    CHECK(mc.var_ > 0.0);
+    spdlog::get("logger")->info("VaR 300 assets historical {}us, Monte Carlo 20000 paths {}us", hist_us, mc_us);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "TimeSeries.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace AARC {
+    namespace VaR {
+        /* Value at risk and expected shortfall of a set of holdings, by historical simulation over stored history or
+        Monte Carlo from the covariance of recent returns. Exposures are the money held in each asset, losses are
+        positive and in the same money */
+
+        // Log close to close returns on the timestamps every asset has, r_[t * assets_.size() + a]
+        struct Returns {
+            std::vector<uint64_t> assets_;
+            std::vector<size_t>   ts_; // Timestamp of the later close of each return
+            std::vector<double>   r_;
+        };
+
+        struct Measures {
+            double var_       = 0.0;
+            double es_        = 0.0; // Mean loss beyond the VaR
+            size_t scenarios_ = 0;
+        };
+
+        auto returns(const std::vector<TSData> &series) -> Returns;
+
+        // Returns of the assets from the daily (TSDATA1440) table, or another bar size through units
+        auto load(const std::string &db, const std::vector<uint64_t> &assets, const uint64_t start, const uint64_t end,
+                  const int units = 1440) -> Returns;
+
+        // Every stored return is a scenario, revalued exactly (exposure * (e^r - 1))
+        auto historical(const Returns &returns, const std::vector<double> &exposures, const double confidence = 0.99)
+            -> Measures;
+
+        /* Correlated normal returns from the mean and covariance of the last window returns (all of them if 0),
+         * through its Cholesky factor */
+        auto monte_carlo(const Returns &returns, const std::vector<double> &exposures, const double confidence = 0.99,
+                         const size_t paths = 100000, const size_t window = 250, const uint64_t seed = 1) -> Measures;
+
+        // VaR and ES of a set of losses, reordered in place
+        auto measure(std::vector<double> &losses, const double confidence) -> Measures;
+    } // namespace VaR
+} // namespace AARC
@@ -0,0 +1,169 @@
+#include "WalkForward.h"
+#include "Random.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <doctest\doctest.h>
+#include <ppl.h>
+#include <spdlog\spdlog.h>
+
+auto AARC::WalkForward::folds(const size_t bars, const Settings &settings) -> std::vector<Fold> {
+    auto out = std::vector<Fold>();
+    if (settings.train_bars_ == 0 || settings.test_bars_ == 0) return out;
+    for (auto test = settings.train_bars_; test < bars; test += settings.test_bars_) {
+        auto f         = Fold();
+        f.train_begin_ = settings.anchored_ ? 0 : test - settings.train_bars_;
+        f.test_begin_  = test;
+        f.test_end_    = std::min(bars, test + settings.test_bars_);
+        out.emplace_back(f);
+    }
+    return out;
+}
+
+auto AARC::WalkForward::run(const TSData &bars, const std::vector<Backtest::Signals> &signals,
+                            const std::vector<Backtest::Rules> &rules, const Settings &settings) -> Result {
+    using namespace std;
+    MethodLogger mlog("WalkForward::run");
+    auto         out = Result();
+    out.folds_       = folds(bars.ts_.size(), settings);
+    if (out.folds_.empty() || rules.empty()) {
+        mlog.logger()->error("No folds of {} + {} bars in {} bars", settings.train_bars_, settings.test_bars_,
+                             bars.ts_.size());
+        return out;
+    }
+
+    // Totals at every training window's ends from one sweep
+    auto checkpoints = vector<size_t>();
+    for (const auto &f : out.folds_) {
+        checkpoints.emplace_back(f.train_begin_);
+        checkpoints.emplace_back(f.test_begin_);
+    }
+    sort(begin(checkpoints), end(checkpoints));
+    checkpoints.erase(unique(begin(checkpoints), end(checkpoints)), end(checkpoints));
+    const auto marks = Backtest::totals(bars, signals, rules, checkpoints);
+    if (marks.size() != rules.size()) return Result();
+    const auto at = [&](const size_t bar) {
+        return size_t(lower_bound(begin(checkpoints), end(checkpoints), bar) - begin(checkpoints));
+    };
+
+    concurrency::parallel_for(size_t(0), out.folds_.size(), [&](const size_t i) {
+        auto &     f     = out.folds_[i];
+        const auto from  = at(f.train_begin_), to = at(f.test_begin_);
+        const auto count = f.test_begin_ - f.train_begin_;
+        auto       score = -numeric_limits<double>::infinity();
+        for (auto k = size_t(0); k < rules.size(); ++k) {
+            const auto s = Backtest::stats(marks[k][from], marks[k][to], count, settings.bars_per_year_);
+            const auto v = settings.objective_ == Objective::SHARPE ? s.sharpe_ : s.total_return_;
+            if (v > score) {
+                score        = v;
+                f.best_      = k;
+                f.in_sample_ = s;
+            }
+        }
+    });
+
+    // The chosen rules over each test window
+    auto tests = vector<Backtest::Result>(out.folds_.size());
+    concurrency::parallel_for(size_t(0), out.folds_.size(), [&](const size_t i) {
+        auto &f  = out.folds_[i];
+        tests[i] = Backtest::run(bars, signals.size() == 1 ? signals.front() : signals[f.best_], rules[f.best_],
+                                 f.test_begin_, f.test_end_, settings.bars_per_year_);
+        f.out_of_sample_ = tests[i].stats_;
+    });
+
+    // Strung together, the stats of the joined curve
+    auto base = 1.0, last = 1.0, peak = 1.0, drawdown = 0.0;
+    auto total = Backtest::Totals();
+    for (auto i = size_t(0); i < tests.size(); ++i) {
+        for (const auto e : tests[i].equity_) {
+            const auto v = base * e, r = v / last - 1.0;
+            total.sum_ += r;
+            total.sum_sq_ += r * r;
+            peak     = max(peak, v);
+            drawdown = max(drawdown, 1.0 - v / peak);
+            last     = v;
+            out.equity_.emplace_back(static_cast<float>(v));
+        }
+        base = last;
+        total.trades_ += out.folds_[i].out_of_sample_.trades_;
+        total.wins_ += out.folds_[i].out_of_sample_.win_rate_ * out.folds_[i].out_of_sample_.trades_;
+    }
+    total.equity_            = last;
+    out.stats_               = Backtest::stats(Backtest::Totals(), total, out.equity_.size(), settings.bars_per_year_);
+    out.stats_.max_drawdown_ = drawdown;
+    return out;
+}
+
+TEST_CASE("WalkForward folds") {
+    using namespace AARC::WalkForward;
+    auto settings        = Settings();
+    settings.train_bars_ = 500;
+    settings.test_bars_  = 250;
+    auto f               = folds(4100, settings);
+    REQUIRE(f.size() == 15);
+    CHECK(f[1].train_begin_ == 250);
+    CHECK(f[1].test_begin_ == 750);
+    CHECK(f.back().test_end_ == 4100);
+    settings.anchored_ = true;
+    CHECK(folds(4100, settings)[3].train_begin_ == 0);
+    CHECK(folds(400, settings).empty());
+}
+
+TEST_CASE("WalkForward regime change") {
+    using namespace AARC::WalkForward;
+    using namespace AARC::Backtest;
+    const auto b = AARC::Random::walk(4000, 9, AARC::Random::Walk{0.002, 0.0, 0.001, 2000});
+    // Always long, always short and always flat
+    const auto signals = std::vector<Signals>{Signals{std::vector<int>(4000, 1), 0},
+                                              Signals{std::vector<int>(4000, -1), 0}, Signals{{}, 0}};
+    const auto rules     = std::vector<Rules>(3);
+    auto       settings  = Settings();
+    settings.train_bars_ = 500;
+    settings.test_bars_  = 250;
+    const auto r         = run(b, signals, rules, settings);
+    REQUIRE(r.folds_.size() == 14);
+    CHECK(r.folds_.front().best_ == 0);
+    CHECK(r.folds_.back().best_ == 1);
+    // Training the whole way through the down trend picks the short
+    for (const auto &f : r.folds_) {
+        if (f.train_begin_ >= 2000) CHECK(f.best_ == 1);
+        if (f.test_begin_ <= 2000) CHECK(f.best_ == 0);
+    }
+    REQUIRE(r.equity_.size() == 3500);
+    auto compounded = 1.0;
+    for (const auto &f : r.folds_) compounded *= 1.0 + f.out_of_sample_.total_return_;
+    CHECK(r.equity_.back() == doctest::Approx(compounded).epsilon(1e-5));
+    CHECK(r.stats_.total_return_ == doctest::Approx(compounded - 1.0).epsilon(1e-5));
+    CHECK(r.stats_.sharpe_ > 0.0);
+
+    // The totals over all the bars are the stats of the whole run
+    const auto marks = totals(b, signals, rules, std::vector<size_t>{0, 4000});
+    const auto whole = run(b, signals[0], rules[0]);
+    CHECK(stats(marks[0][0], marks[0][1], 4000).sharpe_ == doctest::Approx(whole.stats_.sharpe_));
+    CHECK(stats(marks[0][0], marks[0][1], 4000).total_return_ == doctest::Approx(whole.stats_.total_return_));
+}
+
+TEST_CASE("WalkForward benchmark" * doctest::test_suite("benchmark") * doctest::skip()) {
+    using namespace AARC::WalkForward;
+    using namespace AARC::Backtest;
+    using namespace std::chrono;
+    const auto b     = AARC::Random::walk(100000, 9, AARC::Random::Walk{0.002, 0.0, 0.001, 50000});
+    auto       rules = std::vector<Rules>();
+    for (auto i = 0; i < 256; ++i) rules.emplace_back(Rules{0.002f * (i % 16), 0.002f * (i / 16), 0, 0.0001f});
+    auto side = std::vector<int>(b.ts_.size(), 0);
+    for (auto j = size_t(0); j < side.size(); j += 50) side[j] = j % 150 == 0 ? -1 : 1;
+    const auto signals   = std::vector<Signals>{Signals{side, 0}};
+    auto       settings  = Settings();
+    settings.train_bars_ = 20000;
+    settings.test_bars_  = 5000;
+    auto       start     = high_resolution_clock::now();
+    const auto sweep     = AARC::Backtest::run(b, signals, rules);
+    const auto sweep_ms  = duration_cast<milliseconds>(high_resolution_clock::now() - start).count();
+    start                = high_resolution_clock::now();
+    const auto r         = run(b, signals, rules, settings);
+    const auto wf_ms     = duration_cast<milliseconds>(high_resolution_clock::now() - start).count();
+    CHECK(r.folds_.size() == 16);
+    spdlog::get("logger")->info("WalkForward 256 rules x 100000 bars, 16 folds {}ms against one sweep {}ms", wf_ms,
+                                sweep_ms);
+}
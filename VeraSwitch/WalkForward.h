@@ -0,0 +1,47 @@
+#pragma once
+#include "Backtest.h"
+#include <vector>
+
+namespace AARC {
+    namespace WalkForward {
+        /* Walk-forward optimisation of backtest parameters. History is split into training windows each followed by
+        a test window, the best parameter set on a training window is the one traded over its test window, and the
+        test windows strung together are the out of sample result.
+        The signals are calculated once over all the history and shared by every fold. One sweep of all the parameter
+        sets over all the bars records running totals at the fold boundaries, so ranking the parameters on any
+        training window is a difference of two totals and the folds cost little more than a single sweep. Only the
+        chosen parameters are then run over the test windows, from flat, a fold per task */
+
+        enum class Objective { SHARPE, TOTAL_RETURN };
+
+        struct Settings {
+            size_t    train_bars_    = 0;
+            size_t    test_bars_     = 0;     // Also the step from one fold to the next
+            bool      anchored_      = false; // Training windows all start at the first bar and grow
+            Objective objective_     = Objective::SHARPE;
+            double    bars_per_year_ = 252.0;
+        };
+
+        struct Fold {
+            size_t          train_begin_ = 0;
+            size_t          test_begin_  = 0; // Also the end of training
+            size_t          test_end_    = 0;
+            size_t          best_        = 0; // Index of the chosen rules
+            Backtest::Stats in_sample_;       // Without the drawdown
+            Backtest::Stats out_of_sample_;
+        };
+
+        // Fold windows of bars, the last test window may be short
+        auto folds(const size_t bars, const Settings &settings) -> std::vector<Fold>;
+
+        struct Result {
+            std::vector<Fold>  folds_;
+            std::vector<float> equity_; // Out of sample from the first test bar, starting from 1
+            Backtest::Stats    stats_;  // Of the out of sample equity
+        };
+
+        // Signals and rules as for Backtest::run, one set of signals for every rules or one each
+        auto run(const TSData &bars, const std::vector<Backtest::Signals> &signals,
+                 const std::vector<Backtest::Rules> &rules, const Settings &settings) -> Result;
+    } // namespace WalkForward
+} // namespace AARC